@@ -0,0 +1,624 @@
+#include "bucket_storage.hpp"
+#include "group_aggregate.hpp"
+#include "hash_join.hpp"
+#include "multi_bucket_storage.hpp"
+#include "perf_counters.hpp"
+#include "query_pipeline.hpp"
+#include "sharded_counter.hpp"
+#include "slab_cache.hpp"
+#include "thread_affinity.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using bs_sizet_t = BucketStorage< size_t >;
+
+std::unique_ptr< PerfCounters > perf;
+
+template< typename F >
+void measure(const std::string& name, size_t operations, F f)
+{
+	if (perf)
+		perf->start();
+	auto start = std::chrono::steady_clock::now();
+	f();
+	double milliseconds = std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - start).count();
+	PerfCounters::values_type counters;
+	if (perf)
+		counters = perf->stop();
+
+	std::printf("%-40s %10.3f ms %10.2f ns/op\n", name.c_str(), milliseconds, milliseconds * 1e6 / operations);
+	if (!perf)
+		return;
+
+	for (size_t counter = 0; counter < PerfCounters::Count; ++counter)
+	{
+		const char* counterName = PerfCounters::name(PerfCounters::Counter(counter));
+		if (counters[counter])
+			std::printf("    %-36s %14.3f /op%s\n",
+						counterName,
+						double(*counters[counter]) / operations,
+						perf->scaled(PerfCounters::Counter(counter)) ? " (scaled)" : "");
+		else
+			std::printf("    %-36s %14s\n", counterName, "n/a");
+	}
+}
+
+bs_sizet_t fill(size_t n, size_t blockCapacity, size_t offset)
+{
+	bs_sizet_t result(blockCapacity);
+	for (size_t i = 0; i < n; ++i)
+		result.insert(offset + i);
+	return result;
+}
+
+void benchInsert(size_t n)
+{
+	bs_sizet_t storage;
+	measure("insert", n, [&] { storage = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0); });
+}
+
+void benchBulkBuild(size_t n)
+{
+	std::vector< size_t > sorted(n);
+	std::iota(sorted.begin(), sorted.end(), 0);
+	bs_sizet_t storage;
+	measure("bulk_build_sorted", n, [&] { storage.bulk_build_sorted(sorted); });
+
+	bs_sizet_t stable;
+	stable.set_stable_order(true);
+	measure(
+		"insert (stable order)",
+		n,
+		[&]
+		{
+			for (size_t value : sorted)
+				stable.insert(value);
+		});
+}
+
+void benchIterate(size_t n)
+{
+	bs_sizet_t storage = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0);
+	size_t sum = 0;
+	measure(
+		"iterate",
+		n,
+		[&]
+		{
+			for (size_t value : storage)
+				sum += value;
+		});
+	std::printf("%-40s %10zu\n", "iterate checksum", sum);
+}
+
+void benchErase(size_t n)
+{
+	bs_sizet_t storage = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0);
+	measure(
+		"erase (every other element)",
+		n / 2,
+		[&]
+		{
+			for (auto it = storage.begin(); it != storage.end();)
+			{
+				it = storage.erase(it);
+				if (it != storage.end())
+					++it;
+			}
+		});
+}
+
+void benchEraseBatch(size_t n)
+{
+	constexpr size_t TICK = 4096;
+	std::vector< bs_sizet_t::const_iterator > scattered;
+	bs_sizet_t storage;
+	auto prepare = [&]
+	{
+		storage = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0);
+		scattered.clear();
+		size_t i = 0;
+		for (auto it = storage.cbegin(); it != storage.cend(); ++it, ++i)
+			if ((i * 0x9e3779b97f4a7c15ULL >> 60) < 4)
+				scattered.push_back(it);
+		std::shuffle(scattered.begin(), scattered.end(), std::mt19937_64(42));
+	};
+
+	prepare();
+	measure(
+		"erase scattered, 4096 per tick (one by one)",
+		scattered.size(),
+		[&]
+		{
+			for (const auto& it : scattered)
+				storage.erase(it);
+		});
+
+	prepare();
+	measure("erase scattered, 4096 per tick (erase_batch)",
+			scattered.size(),
+			[&]
+			{
+				std::span< const bs_sizet_t::const_iterator > all(scattered);
+				for (size_t offset = 0; offset < all.size(); offset += TICK)
+					storage.erase_batch(all.subspan(offset, std::min(TICK, all.size() - offset)));
+			});
+}
+
+void benchMerge(size_t n)
+{
+	bs_sizet_t target = fill(n, 64, 0);
+	bs_sizet_t source = fill(n, 100, n);
+	size_t moves = 0;
+	measure("merge (adopt buckets)", n, [&] { moves = target.merge(source); });
+	std::printf("%-40s %10zu\n", "merge element moves", moves);
+
+	bs_sizet_t naiveTarget = fill(n, 64, 0);
+	bs_sizet_t naiveSource = fill(n, 100, n);
+	measure(
+		"merge (naive re-insertion)",
+		n,
+		[&]
+		{
+			for (size_t& value : naiveSource)
+				naiveTarget.insert(std::move(value));
+			naiveSource.clear();
+		});
+}
+
+void benchCopyDestroy(size_t n)
+{
+	bs_sizet_t source = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0);
+	std::optional< bs_sizet_t > copy;
+	measure("copy", n, [&] { copy.emplace(source); });
+	measure("clear", n, [&] { copy->clear(); });
+
+	copy.emplace(source);
+	std::future< void > destroyed;
+	measure("detach_destroy (caller side)", n, [&] { destroyed = copy->detach_destroy(); });
+	destroyed.wait();
+}
+
+void benchQuery(size_t n)
+{
+	bs_sizet_t storage = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0);
+	auto even = [](size_t value) { return value % 2 == 0; };
+	auto square = [](size_t value) { return value * value; };
+	size_t loop = 0;
+	measure(
+		"filter/map/sum (iterator loop)",
+		n,
+		[&]
+		{
+			for (size_t value : storage)
+				if (even(value))
+					loop += square(value);
+		});
+
+	size_t fused = 0;
+	measure("filter/map/sum (fused pipeline)",
+			n,
+			[&] { fused = storage | query_where(even) | query_select(square) | query_sum(); });
+
+	bs_sizet_t::frozen_storage frozen = storage.freeze();
+	size_t contiguous = 0;
+	measure("filter/map/sum (frozen pipeline)",
+			n,
+			[&] { contiguous = frozen | query_where(even) | query_select(square) | query_sum(); });
+	std::printf("%-40s %10s\n", "pipeline checksums", loop == fused && fused == contiguous ? "match" : "MISMATCH");
+}
+
+void benchGroupBy(size_t n)
+{
+	bs_sizet_t storage = fill(n, bs_sizet_t::DEFAULT_BLOCK_CAPACITY, 0);
+	for (size_t groups : { size_t(1000), n / 2 })
+	{
+		auto key = [groups](size_t value) { return (value * 0x9e3779b97f4a7c15ULL >> 17) % groups; };
+		std::string suffix = " (" + std::to_string(groups) + " groups)";
+
+		std::unordered_map< size_t, size_t > naive;
+		measure("group-by sum, unordered_map" + suffix,
+				n,
+				[&]
+				{
+					for (size_t value : storage)
+						naive[key(value)] += value;
+				});
+
+		size_t flatGroups = 0;
+		measure("group-by sum, flat table" + suffix,
+				n,
+				[&] { flatGroups = (storage | query_group_aggregate(key, query_sum())).size(); });
+
+		size_t radixGroups = 0;
+		measure("group-by sum, flat table, 6 radix bits" + suffix,
+				n,
+				[&] { radixGroups = (storage | query_group_aggregate(key, query_sum(), 6)).size(); });
+		std::printf("%-40s %10s\n",
+					"group counts",
+					naive.size() == flatGroups && flatGroups == radixGroups ? "match" : "MISMATCH");
+	}
+}
+
+struct BenchUser
+{
+	size_t id;
+	size_t region;
+};
+
+struct BenchOrder
+{
+	size_t user;
+	size_t amount;
+};
+
+void benchJoin(size_t n)
+{
+	BucketStorage< BenchUser > users;
+	for (size_t id = 0; id < n / 10; ++id)
+		users.insert(BenchUser{ id, id % 16 });
+	BucketStorage< BenchOrder > orders;
+	for (size_t i = 0; i < n; ++i)
+		orders.insert(BenchOrder{ (i * 0x9e3779b97f4a7c15ULL >> 17) % (n / 10), i });
+
+	size_t naive = 0;
+	measure("join (unordered_map lookups)",
+			n,
+			[&]
+			{
+				std::unordered_map< size_t, const BenchUser* > index;
+				for (const BenchUser& user : users)
+					index.emplace(user.id, &user);
+				for (const BenchOrder& order : orders)
+				{
+					auto found = index.find(order.user);
+					if (found != index.end())
+						naive += found->second->region;
+				}
+			});
+
+	size_t joined = 0;
+	measure("join (hash_join, batched)",
+			n,
+			[&]
+			{
+				query_hash_join(
+					users,
+					orders,
+					[](const BenchUser& user) { return user.id; },
+					[](const BenchOrder& order) { return order.user; },
+					[&](std::span< const std::pair< const BenchUser*, const BenchOrder* > > batch)
+					{
+						for (const auto& match : batch)
+							joined += match.first->region;
+					});
+			});
+	std::printf("%-40s %10s\n", "join checksums", naive == joined ? "match" : "MISMATCH");
+}
+
+struct Record64
+{
+	char payload[64];
+};
+
+void benchHeterogeneous(size_t n)
+{
+	using variant_type = std::variant< size_t, Record64 >;
+	BucketStorage< variant_type > variants;
+	MultiBucketStorage< size_t, Record64 > multi;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (i % 8 == 0)
+		{
+			variants.insert(variant_type(Record64{ { char(i) } }));
+			multi.insert(Record64{ { char(i) } });
+		}
+		else
+		{
+			variants.insert(variant_type(i));
+			multi.insert(i);
+		}
+	}
+
+	size_t visited = 0;
+	measure("mixed scan (variant storage, visit)",
+			n,
+			[&]
+			{
+				for (const variant_type& value : variants)
+					visited += std::visit(
+						[](const auto& alternative)
+						{
+							if constexpr (std::is_same_v< std::remove_cvref_t< decltype(alternative) >, size_t >)
+								return alternative;
+							else
+								return size_t(alternative.payload[0]);
+						},
+						value);
+			});
+
+	size_t chained = 0;
+	measure("mixed scan (per-type chains)",
+			n,
+			[&]
+			{
+				for (size_t value : multi.of< size_t >())
+					chained += value;
+				for (const Record64& record : multi.of< Record64 >())
+					chained += size_t(record.payload[0]);
+			});
+	std::printf("%-40s %10s\n", "mixed scan checksums", visited == chained ? "match" : "MISMATCH");
+	std::printf("%-40s %10zu\n", "variant storage bytes", variants.memory_usage());
+	std::printf("%-40s %10zu\n", "per-type chains bytes", multi.memory_usage());
+}
+
+void benchAffinity(size_t n)
+{
+	size_t threads = std::max< size_t >(ThreadAffinityScope::cpu_count(), 2);
+	bs_sizet_t remote;
+	remote.set_parallelism(threads);
+	{
+		ThreadAffinityScope pinned(0);
+		for (size_t i = 0; i < n; ++i)
+			remote.insert(i);
+	}
+	remote.set_thread_affinity(true);
+
+	bs_sizet_t local;
+	local.set_parallelism(threads);
+	local.set_thread_affinity(true);
+	local.reserve(n);
+	for (size_t i = 0; i < n; ++i)
+		local.insert(i);
+
+	auto scan = [](const bs_sizet_t& storage)
+	{
+		return storage.fold_buckets(
+			[] { return size_t(0); },
+			[](size_t& result, const auto& bucket) { bucket.for_each([&result](size_t value) { result += value; }); },
+			[](size_t first, size_t second) { return first + second; });
+	};
+	size_t remoteSum = 0;
+	size_t localSum = 0;
+	measure("pinned scan (touched on cpu 0)", n * 8, [&] { for (int i = 0; i < 8; ++i) remoteSum += scan(remote); });
+	measure("pinned scan (touched by owner)", n * 8, [&] { for (int i = 0; i < 8; ++i) localSum += scan(local); });
+	std::printf("%-40s %10s\n", "pinned scan checksums", remoteSum == localSum ? "match" : "MISMATCH");
+}
+
+template< typename F >
+void runThreads(size_t threads, F work)
+{
+	std::vector< std::thread > workers;
+	for (size_t t = 0; t < threads; ++t)
+		workers.emplace_back(work, t);
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void benchContention(size_t n)
+{
+	size_t threads = std::max< size_t >(ThreadAffinityScope::cpu_count(), 4);
+	size_t perThread = n / threads;
+
+	std::atomic< int64_t > shared(0);
+	measure("counter (one shared atomic)",
+			perThread * threads,
+			[&]
+			{
+				runThreads(threads,
+						   [&](size_t)
+						   {
+							   for (size_t i = 0; i < perThread; ++i)
+								   shared.fetch_add(1, std::memory_order_relaxed);
+						   });
+			});
+
+	std::vector< std::atomic< int64_t > > packed(threads);
+	measure("counter (packed per-thread atomics)",
+			perThread * threads,
+			[&]
+			{
+				runThreads(threads,
+						   [&](size_t t)
+						   {
+							   for (size_t i = 0; i < perThread; ++i)
+								   packed[t].fetch_add(1, std::memory_order_relaxed);
+						   });
+			});
+
+	ShardedCounter sharded;
+	measure("counter (sharded, padded)",
+			perThread * threads,
+			[&]
+			{
+				runThreads(threads,
+						   [&](size_t)
+						   {
+							   for (size_t i = 0; i < perThread; ++i)
+								   sharded.add(1);
+						   });
+			});
+	int64_t packedSum = 0;
+	for (const auto& slot : packed)
+		packedSum += slot.load();
+	std::printf("%-40s %10s\n", "counter checksums", shared.load() == packedSum && packedSum == sharded.load() ? "match" : "MISMATCH");
+
+	bs_sizet_t storage;
+	bs_sizet_t::const_iterator fixed = storage.insert(size_t(7));
+	std::atomic< bool > stop(false);
+	std::atomic< size_t > reads(0);
+	std::vector< std::thread > readers;
+	for (size_t t = 1; t < threads; ++t)
+		readers.emplace_back(
+			[&]
+			{
+				size_t local = 0;
+				while (!stop.load(std::memory_order_relaxed))
+					local += *fixed + storage.parallelism();
+				reads.fetch_add(local, std::memory_order_relaxed);
+			});
+#ifdef BUCKET_STORAGE_PADDED_LAYOUT
+	const char* name = "insert/erase beside readers (padded)";
+#else
+	const char* name = "insert/erase beside readers (packed)";
+#endif
+	measure(name,
+			n,
+			[&]
+			{
+				for (size_t i = 0; i < n; ++i)
+					storage.erase(storage.insert(i));
+			});
+	stop = true;
+	for (auto& reader : readers)
+		reader.join();
+	std::printf("%-40s %10zu\n", "storage object bytes", sizeof(bs_sizet_t));
+}
+
+size_t residentBytes()
+{
+#if defined(__linux__)
+	std::ifstream statm("/proc/self/statm");
+	size_t total = 0;
+	size_t resident = 0;
+	if (statm >> total >> resident)
+		return resident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+	return 0;
+}
+
+void benchTrim(size_t n)
+{
+	const size_t blockCapacity = 1024;
+	bs_sizet_t storage(blockCapacity);
+	storage.set_spare_limit(n / blockCapacity + 1);
+	std::vector< bs_sizet_t::const_iterator > its;
+	its.reserve(n);
+	auto spike = [&]
+	{
+		its.clear();
+		for (size_t i = 0; i < n; ++i)
+			its.push_back(storage.insert(i));
+	};
+	auto drain = [&]
+	{
+		for (auto it : its)
+			storage.erase(it);
+	};
+
+	spike();
+	drain();
+	measure("refill from resident spares", n, spike);
+	drain();
+	size_t before = residentBytes();
+	size_t advised = storage.trim();
+	size_t after = residentBytes();
+	measure("refill from trimmed spares", n, spike);
+	drain();
+
+	bs_sizet_t fresh(blockCapacity);
+	measure("insert into fresh buckets", n, [&] { for (size_t i = 0; i < n; ++i) fresh.insert(i); });
+	std::printf("%-40s %10zu\n", "trimmed bytes", advised);
+	std::printf("%-40s %10zu\n", "resident bytes before trim", before);
+	std::printf("%-40s %10zu\n", "resident bytes after trim", after);
+}
+
+void benchShortLived(size_t n)
+{
+	const size_t perStorage = 256;
+	const size_t rounds = n / perStorage + 1;
+	auto churn = [&]
+	{
+		for (size_t round = 0; round < rounds; ++round)
+		{
+			bs_sizet_t storage;
+			for (size_t i = 0; i < perStorage; ++i)
+				storage.insert(i);
+		}
+	};
+
+	SlabCache::local().set_limit(0);
+	SlabCache::shared().set_limit(0);
+	measure("short-lived storages, no slab cache", rounds * perStorage, churn);
+
+	SlabCache::shared().set_limit(SlabCache::DEFAULT_SHARED_LIMIT);
+	SlabCache::local().set_limit(SlabCache::DEFAULT_LOCAL_LIMIT);
+	size_t misses = SlabCache::local().misses();
+	measure("short-lived storages, slab cache", rounds * perStorage, churn);
+	std::printf("%-40s %10zu\n", "slab cache misses", SlabCache::local().misses() - misses);
+}
+
+template< typename T >
+void reportOverhead(const char* name, size_t n, const T& value)
+{
+	BucketStorage< T > storage;
+	for (size_t i = 0; i < n; ++i)
+		storage.insert(value);
+
+	double estimate = double(BucketStorage< T >::bytes_for(n)) / n;
+	double measured = double(storage.memory_usage()) / n;
+	std::printf("%-16s %8zu %14.2f %14.2f %14.2f\n", name, sizeof(T), estimate, measured, measured - double(sizeof(T)));
+}
+
+void benchOverhead(size_t n)
+{
+	std::printf("%-16s %8s %14s %14s %14s\n", "type", "sizeof", "estimate B/el", "measured B/el", "overhead B/el");
+	reportOverhead("uint8_t", n, uint8_t(1));
+	reportOverhead("int", n, 1);
+	reportOverhead("size_t", n, size_t(1));
+	reportOverhead("std::string", n, std::string("short"));
+	reportOverhead("Record64", n, Record64());
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = 1000000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string_view(argv[i]) == "--perf")
+			perf = std::make_unique< PerfCounters >();
+		else
+			n = std::stoul(argv[i]);
+	}
+
+	if (perf && !perf->available())
+		std::printf("perf_event_open is unavailable, hardware counters are reported as n/a\n");
+
+	benchInsert(n);
+	benchBulkBuild(n);
+	benchIterate(n);
+	benchErase(n);
+	benchEraseBatch(n);
+	benchMerge(n);
+	benchCopyDestroy(n);
+	benchQuery(n);
+	benchGroupBy(n);
+	benchJoin(n);
+	benchHeterogeneous(n);
+	benchAffinity(n);
+	benchContention(n);
+	benchTrim(n);
+	benchShortLived(n);
+	benchOverhead(n);
+	return 0;
+}
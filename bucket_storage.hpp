@@ -1,9 +1,71 @@
 #ifndef BUCKET_STORAGE_H
 #define BUCKET_STORAGE_H
 
+#include "coroutine_tasks.hpp"
+#include "memory_budget.hpp"
+#include "slab_cache.hpp"
+#include "thread_affinity.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#ifdef BUCKET_STORAGE_TRACE
+#include "trace_recorder.hpp"
+#endif
+
+#ifdef BUCKET_STORAGE_LATENCY
+#include "latency_histogram.hpp"
+#define BUCKET_STORAGE_MEASURE(event) LatencyScope latencyScope(LatencyEvent::event)
+#else
+#define BUCKET_STORAGE_MEASURE(event)
+#endif
+
+#ifdef BUCKET_STORAGE_GENERATIONS
+#include <atomic>
+#endif
+
+#ifdef BUCKET_STORAGE_PADDED_LAYOUT
+#include "sharded_counter.hpp"
+#define BUCKET_STORAGE_HOT alignas(DESTRUCTIVE_INTERFERENCE_SIZE)
+#else
+#define BUCKET_STORAGE_HOT
+#endif
+
+#ifdef BUCKET_STORAGE_COUNTERS
+#include "operation_counters.hpp"
+#define BUCKET_STORAGE_COUNT(counter, amount) \
+	(std::is_constant_evaluated() ? void() : void(OperationCounters::local().counter += (amount)))
+#else
+#define BUCKET_STORAGE_COUNT(counter, amount)
+#endif
 
 // ------------------------------------------
 // START OF BUCKET STORAGE INTERFACE
@@ -16,9 +78,15 @@ class BucketStorage
 	class AbstractIterator;
 	class Bucket;
 	class GeneralBucketContent;
+	class ElementHash;
+	class Transaction;
+	class BucketView;
+	class FrozenStorage;
 
 	template< bool IsConst >
 	friend class AbstractIterator;
+	template< typename U >
+	friend bool equal_unordered(const BucketStorage< U >& first, const BucketStorage< U >& second);
 
   public:
 	using value_type = T;
@@ -26,60 +94,178 @@ class BucketStorage
 	using const_reference = const T&;
 	using iterator = AbstractIterator< false >;
 	using const_iterator = AbstractIterator< true >;
+	using transaction = Transaction;
+	using bucket_view = BucketView;
+	using frozen_storage = FrozenStorage;
 	using difference_type = std::ptrdiff_t;
 	using size_type = std::size_t;
 	using id_type = uint64_t;
+#ifdef BUCKET_STORAGE_GENERATIONS
+	using generation_type = uint32_t;
+#endif
 
 	static constexpr size_type DEFAULT_BLOCK_CAPACITY = 64;
+	static constexpr size_type PARALLEL_BUCKET_THRESHOLD = 64;
+	static constexpr size_type DEFAULT_BUCKETS_PER_STEP = 64;
+	static constexpr size_type ERASE_PREFETCH_DISTANCE = 8;
+	static constexpr size_type NO_OWNER = std::numeric_limits< size_type >::max();
+	static constexpr size_type SLAB_PAGE_SIZE = 4096;
+	static constexpr size_type PAGED_SLAB_BYTES = 2 * SLAB_PAGE_SIZE;
 
   private:
-	GeneralBucketContent generalContent;
-	size_type dataSize;
-	size_type blocksCount;
+	GeneralBucketContent* generalContent;
 	Bucket* first;
 	Bucket* last;
+	BUCKET_STORAGE_HOT size_type dataSize;
+	size_type blocksCount;
+	size_type blocksCapacity;
 	Bucket* incomplete;
 
   public:
-	BucketStorage();
-	BucketStorage(const BucketStorage< T >& other);
-	BucketStorage(BucketStorage< T >&& other) noexcept;
-	explicit BucketStorage(size_type block_capacity);
-	~BucketStorage() noexcept;
+	constexpr BucketStorage();
+	constexpr BucketStorage(const BucketStorage< T >& other);
+	constexpr BucketStorage(BucketStorage< T >&& other) noexcept;
+	constexpr explicit BucketStorage(size_type block_capacity);
+	constexpr ~BucketStorage() noexcept;
 
-	BucketStorage< T >& operator=(const BucketStorage< T >& other);
-	BucketStorage< T >& operator=(BucketStorage< T >&& other) noexcept;
+	constexpr BucketStorage< T >& operator=(const BucketStorage< T >& other);
+	constexpr BucketStorage< T >& operator=(BucketStorage< T >&& other) noexcept;
 
 	template< typename U >
-	iterator insert(U&& value);
-	iterator erase(const_iterator it);
-
-	[[nodiscard]] bool empty() const noexcept;
-	[[nodiscard]] size_type size() const noexcept;
-	[[nodiscard]] size_type capacity() const noexcept;
-	[[nodiscard]] size_type max_size() const noexcept;
-
+	constexpr iterator insert(U&& value);
+	template< std::ranges::input_range R >
+	constexpr void bulk_build_sorted(R&& range);
+	constexpr iterator erase(const_iterator it);
+	size_type erase_batch(std::span< const const_iterator > its);
+
+	[[nodiscard]] constexpr bool empty() const noexcept;
+	[[nodiscard]] constexpr size_type size() const noexcept;
+	[[nodiscard]] constexpr size_type capacity() const noexcept;
+	[[nodiscard]] constexpr size_type max_size() const noexcept;
+
+	void reserve(size_type n);
 	void shrink_to_fit();
-	void clear();
-	void swap(BucketStorage< T >& other) noexcept;
+	size_type trim(std::chrono::milliseconds idle = std::chrono::milliseconds(0));
+	constexpr void clear();
+	[[nodiscard]] std::future< void > detach_destroy();
+	[[nodiscard]] frozen_storage freeze();
+
+	[[nodiscard]] Generator< const T& > elements() const;
+	[[nodiscard]] Generator< bucket_view > buckets() const;
+	[[nodiscard]] MaintenanceTask co_compact(size_type buckets_per_step = DEFAULT_BUCKETS_PER_STEP);
+	[[nodiscard]] MaintenanceTask co_clear(size_type buckets_per_step = DEFAULT_BUCKETS_PER_STEP);
+	[[nodiscard]] MaintenanceTask co_copy(BucketStorage< T >& target, size_type buckets_per_step = DEFAULT_BUCKETS_PER_STEP) const;
+	constexpr void swap(BucketStorage< T >& other) noexcept;
 	friend void swap(BucketStorage< T >& first, BucketStorage< T >& second) noexcept;
 
-	iterator get_to_distance(iterator it, difference_type distance);
-
-	iterator begin() noexcept;
-	const_iterator begin() const noexcept;
-	const_iterator cbegin() const noexcept;
-	iterator end() noexcept;
-	const_iterator end() const noexcept;
-	const_iterator cend() const noexcept;
+	constexpr iterator get_to_distance(iterator it, difference_type distance);
+
+	template< typename Hash = ElementHash >
+	[[nodiscard]] size_type content_hash(Hash hash = Hash()) const;
+
+	template< typename F >
+	void drain(F consumer);
+	template< typename R, typename Map, typename Reduce >
+	R reduce_buckets(R init, Map map, Reduce reduce) const;
+	template< typename Make, typename Fold, typename Merge >
+	std::invoke_result_t< Make& > fold_buckets(Make make, Fold fold, Merge merge) const;
+	void drain_into(BucketStorage< T >& other);
+	size_type merge(BucketStorage< T >& other);
+
+	void set_memory_budget(std::shared_ptr< MemoryBudget > budget);
+	[[nodiscard]] const std::shared_ptr< MemoryBudget >& memory_budget() const noexcept;
+
+	void set_parallelism(size_type threads) noexcept;
+	[[nodiscard]] size_type parallelism() const noexcept;
+	constexpr void set_stable_order(bool enabled) noexcept;
+	[[nodiscard]] constexpr bool stable_order() const noexcept;
+	void set_thread_affinity(bool enabled) noexcept;
+	[[nodiscard]] bool thread_affinity() const noexcept;
+	void set_spare_limit(size_type buckets);
+	[[nodiscard]] size_type spare_limit() const noexcept;
+
+	[[nodiscard]] static constexpr size_type bytes_for(size_type n, size_type block_capacity = DEFAULT_BLOCK_CAPACITY) noexcept;
+	[[nodiscard]] size_type memory_usage() const;
+
+	template< size_type N >
+	[[nodiscard]] constexpr std::array< T, N > to_array() const;
+
+#ifdef BUCKET_STORAGE_TRACE
+	void set_trace_recorder(TraceRecorder* recorder);
+#endif
+#ifdef BUCKET_STORAGE_GENERATIONS
+	[[nodiscard]] bool valid(const_iterator it) const noexcept;
+#endif
+
+	constexpr iterator begin() noexcept;
+	constexpr const_iterator begin() const noexcept;
+	constexpr const_iterator cbegin() const noexcept;
+	constexpr iterator end() noexcept;
+	constexpr const_iterator end() const noexcept;
+	constexpr const_iterator cend() const noexcept;
 
   private:
-	void prepareInsert();
-	void completeInsert();
-	void undoInsert();
-	void resetPointers();
-	void cleanup();
-	void deepCopy(const BucketStorage< T >& other);
+	constexpr void makeRoomForInsert();
+	[[nodiscard]] constexpr Bucket* prepareInsert();
+	constexpr void completeInsert(Bucket* target);
+	constexpr void undoInsert(Bucket* target);
+	[[nodiscard]] constexpr Bucket* appendBucket();
+	[[nodiscard]] constexpr Bucket* newBucket(Bucket* next, Bucket* prev, Bucket* incomplete);
+	constexpr void releaseSpares() noexcept;
+	bool parkBucket(Bucket* bucket) noexcept;
+	constexpr void pushIncomplete(Bucket* bucket) noexcept;
+	constexpr void unlinkIncomplete(Bucket* bucket) noexcept;
+	void compactBucket(Bucket* bucket);
+	constexpr void releaseBucket(Bucket* bucket) noexcept;
+	constexpr void detachBucket(Bucket* bucket) noexcept;
+	void adoptBucket(Bucket* bucket) noexcept;
+	constexpr void resetPointers();
+	constexpr void cleanup();
+	constexpr void deepCopy(const BucketStorage< T >& other);
+
+	constexpr void destroyBuckets() noexcept;
+
+	[[nodiscard]] constexpr size_type threadsFor(size_type buckets) const noexcept;
+	template< typename R, typename Map, typename Reduce >
+	R reduceBuckets(R init, Map map, Reduce reduce) const;
+	template< typename Make, typename Fold, typename Merge >
+	std::invoke_result_t< Make& > foldBuckets(Make make, Fold fold, Merge merge) const;
+	template< typename P >
+	[[nodiscard]] std::vector< size_type > chunkBounds(const std::vector< P >& buckets, size_type threads) const;
+	template< typename F >
+	void runChunks(size_type threads, F work) const;
+
+	template< typename U, typename... Args >
+	[[nodiscard]] static constexpr U* createNode(Args&&... args);
+	template< typename U >
+	static constexpr void destroyNode(U* node) noexcept;
+	[[nodiscard]] static size_type allocationSize(const void* pointer, size_type requested) noexcept;
+	static void prefetchForWrite(const void* address) noexcept;
+
+#ifdef BUCKET_STORAGE_TRACE
+	[[nodiscard]] std::vector< TraceRecorder::key_type > traceKeys() const;
+	void traceResync() const;
+#endif
+};
+
+template< typename T >
+[[nodiscard]] bool equal_unordered(const BucketStorage< T >& first, const BucketStorage< T >& second);
+template< auto Build >
+[[nodiscard]] constexpr auto materialize_storage();
+
+// ------------------------------------------
+// START OF ELEMENT HASH INTERFACE
+// ------------------------------------------
+
+template< typename T >
+class BucketStorage< T >::ElementHash
+{
+  public:
+	static constexpr bool HAS_STD_HASH = requires(const T& value) { std::hash< T >()(value); };
+	static constexpr bool IS_BITWISE = std::has_unique_object_representations_v< T >;
+
+	[[nodiscard]] size_type operator()(const T& value) const noexcept;
+	[[nodiscard]] static size_type mix(size_type value) noexcept;
 };
 
 // ------------------------------------------
@@ -91,13 +277,68 @@ class BucketStorage< T >::GeneralBucketContent
 {
 	size_type blockCapacity;
 	id_type idCounter;
+	size_type parallelism;
+	bool stableOrder;
+	bool threadAffinity;
+	std::shared_ptr< MemoryBudget >* budget;
+	bool overcommit;
+	std::vector< Bucket* > spares;
+	size_type spareLimit;
+	size_type spareCapacity;
+#ifdef BUCKET_STORAGE_TRACE
+	TraceRecorder* recorder = nullptr;
+#endif
+#ifdef BUCKET_STORAGE_GENERATIONS
+	std::vector< uint64_t > stamps;
+	std::vector< size_type > freeRecords;
+#endif
 
   public:
-	explicit GeneralBucketContent(size_type blockCapacity = DEFAULT_BLOCK_CAPACITY);
-
-	void setBlockCapacity(size_type value) noexcept;
-	[[nodiscard]] size_type getBlockCapacity() const noexcept;
-	[[nodiscard]] id_type id() noexcept;
+	constexpr explicit GeneralBucketContent(size_type blockCapacity = DEFAULT_BLOCK_CAPACITY);
+	constexpr GeneralBucketContent(const GeneralBucketContent& other);
+	constexpr ~GeneralBucketContent();
+
+	GeneralBucketContent& operator=(const GeneralBucketContent& other) = delete;
+
+	constexpr void setBlockCapacity(size_type value) noexcept;
+	[[nodiscard]] constexpr size_type getBlockCapacity() const noexcept;
+	[[nodiscard]] constexpr id_type id() noexcept;
+	[[nodiscard]] constexpr id_type getIdCounter() const noexcept;
+	constexpr void raiseIdCounter(id_type value) noexcept;
+	constexpr void setParallelism(size_type value) noexcept;
+	[[nodiscard]] constexpr size_type getParallelism() const noexcept;
+	constexpr void setStableOrder(bool value) noexcept;
+	[[nodiscard]] constexpr bool getStableOrder() const noexcept;
+	constexpr void setThreadAffinity(bool value) noexcept;
+	[[nodiscard]] constexpr bool getThreadAffinity() const noexcept;
+	[[nodiscard]] constexpr std::vector< Bucket* >& getSpares() noexcept;
+	[[nodiscard]] constexpr const std::vector< Bucket* >& getSpares() const noexcept;
+	constexpr void setSpareLimit(size_type value);
+	[[nodiscard]] constexpr size_type getSpareLimit() const noexcept;
+	constexpr void addSpareCapacity(size_type value) noexcept;
+	constexpr void subtractSpareCapacity(size_type value) noexcept;
+	[[nodiscard]] constexpr size_type getSpareCapacity() const noexcept;
+
+	void setBudget(std::shared_ptr< MemoryBudget > value);
+	[[nodiscard]] const std::shared_ptr< MemoryBudget >& getBudget() const noexcept;
+	constexpr void charge(size_type bytes);
+	constexpr void forceCharge(size_type bytes) noexcept;
+	constexpr void release(size_type bytes) noexcept;
+	constexpr void setOvercommit(bool value) noexcept;
+	constexpr void makeRoom(size_type bytes);
+	[[nodiscard]] constexpr MemoryBudget::operation_scope deferTrims() const noexcept;
+
+#ifdef BUCKET_STORAGE_TRACE
+	constexpr void setRecorder(TraceRecorder* value) noexcept;
+	[[nodiscard]] constexpr TraceRecorder* getRecorder() const noexcept;
+#endif
+#ifdef BUCKET_STORAGE_GENERATIONS
+	constexpr void reserveRecords(size_type count);
+	[[nodiscard]] constexpr size_type enroll(uint64_t stamp);
+	constexpr void retire(size_type record) noexcept;
+	constexpr void retireAll() noexcept;
+	[[nodiscard]] constexpr bool isLive(size_type record, uint64_t stamp) const noexcept;
+#endif
 };
 
 // ------------------------------------------
@@ -115,65 +356,109 @@ class BucketStorage< T >::Bucket
 	using const_pointer = const T*;
 
   private:
-	GeneralBucketContent* const generalContent;
-	const id_type id;
+	GeneralBucketContent* generalContent;
+	id_type id;
 	Bucket* next;
 	Bucket* prev;
 	Bucket* nextIncomplete;
 	Bucket* prevIncomplete;
+	size_type capacity;
 	T* data;
-	size_type size;
-	size_type firstIndex;
-	size_type lastIndex;
 	size_type* nextData;
 	size_type* prevData;
 	id_type* idData;
+	size_type owner;
+#ifdef BUCKET_STORAGE_GENERATIONS
+	generation_type* generationData = nullptr;
+	size_type record = 0;
+	uint64_t stamp = 0;
+#endif
+	std::chrono::steady_clock::time_point parkedAt{};
+	bool advised = false;
+	bool cached = true;
+	BUCKET_STORAGE_HOT size_type size;
+	size_type firstIndex;
+	size_type lastIndex;
 
   public:
-	Bucket();
-	Bucket(GeneralBucketContent* generalContent, Bucket* next, Bucket* prev, Bucket* incomplete);
-	Bucket(const Bucket& other, GeneralBucketContent* generalContent, Bucket* next, Bucket* prev);
-	~Bucket();
-
-	void setNext(Bucket* value) noexcept;
-	void setPrev(Bucket* value) noexcept;
-	void setNextIncomplete(Bucket* value) noexcept;
-	void setPrevIncomplete(Bucket* value) noexcept;
-
-	[[nodiscard]] Bucket* getNext() const noexcept;
-	[[nodiscard]] Bucket* getPrev() const noexcept;
-	[[nodiscard]] Bucket* getNextIncomplete() const noexcept;
-	[[nodiscard]] Bucket* getPrevIncomplete() const noexcept;
-	[[nodiscard]] id_type getId() const noexcept;
-	[[nodiscard]] id_type getDataId(size_type index);
-	[[nodiscard]] size_type getSize() const noexcept;
-	[[nodiscard]] size_type getFirstIndex() const noexcept;
-	[[nodiscard]] size_type getLastIndex() const noexcept;
-	[[nodiscard]] size_type getNextIndex(size_type index) const noexcept;
-	[[nodiscard]] size_type getPrevIndex(size_type index) const noexcept;
-
-	[[nodiscard]] bool isBegin() const noexcept;
-	[[nodiscard]] bool isEnd() const noexcept;
-	[[nodiscard]] bool isFull() const noexcept;
-	[[nodiscard]] bool isEmpty() const noexcept;
-
-	reference getReference(size_type index);
-	pointer getPointer(size_type index);
-	const_reference getReference(size_type index) const;
-	const_pointer getPointer(size_type index) const;
+	constexpr Bucket();
+	constexpr Bucket(GeneralBucketContent* generalContent, Bucket* next, Bucket* prev, Bucket* incomplete);
+	constexpr Bucket(const Bucket& other, GeneralBucketContent* generalContent, Bucket* next, Bucket* prev);
+	Bucket(GeneralBucketContent* generalContent, id_type id);
+	constexpr ~Bucket();
+
+	constexpr void setNext(Bucket* value) noexcept;
+	constexpr void setPrev(Bucket* value) noexcept;
+	constexpr void setNextIncomplete(Bucket* value) noexcept;
+	constexpr void setPrevIncomplete(Bucket* value) noexcept;
+	constexpr void setOwner(size_type value) noexcept;
+	constexpr void link(Bucket* next, Bucket* prev, Bucket* incomplete);
+	void park() noexcept;
+	[[nodiscard]] size_type advise(std::chrono::steady_clock::time_point cutoff) noexcept;
+	void rebind(GeneralBucketContent* value) noexcept;
+
+	[[nodiscard]] constexpr Bucket* getNext() const noexcept;
+	[[nodiscard]] constexpr Bucket* getPrev() const noexcept;
+	[[nodiscard]] constexpr Bucket* getNextIncomplete() const noexcept;
+	[[nodiscard]] constexpr Bucket* getPrevIncomplete() const noexcept;
+	[[nodiscard]] constexpr id_type getId() const noexcept;
+	[[nodiscard]] constexpr id_type getDataId(size_type index);
+	[[nodiscard]] constexpr size_type getSize() const noexcept;
+	[[nodiscard]] constexpr size_type getCapacity() const noexcept;
+	[[nodiscard]] constexpr size_type getOwner() const noexcept;
+	[[nodiscard]] constexpr size_type getFirstIndex() const noexcept;
+	[[nodiscard]] constexpr size_type getLastIndex() const noexcept;
+	[[nodiscard]] constexpr size_type getNextIndex(size_type index) const noexcept;
+	[[nodiscard]] constexpr size_type getPrevIndex(size_type index) const noexcept;
+	void prefetchSlot(size_type index) const noexcept;
+#ifdef BUCKET_STORAGE_GENERATIONS
+	constexpr void enroll();
+	constexpr void retire() noexcept;
+	[[nodiscard]] constexpr size_type getRecord() const noexcept;
+	[[nodiscard]] constexpr uint64_t getStamp() const noexcept;
+	[[nodiscard]] constexpr generation_type getGeneration(size_type index) const noexcept;
+#endif
+
+	[[nodiscard]] constexpr bool isBegin() const noexcept;
+	[[nodiscard]] constexpr bool isEnd() const noexcept;
+	[[nodiscard]] constexpr bool isFull() const noexcept;
+	[[nodiscard]] constexpr bool isEmpty() const noexcept;
+	[[nodiscard]] static constexpr size_type footprint(size_type capacity) noexcept;
+	[[nodiscard]] size_type memoryUsage() const noexcept;
+
+	constexpr reference getReference(size_type index);
+	constexpr pointer getPointer(size_type index);
+	constexpr const_reference getReference(size_type index) const;
+	constexpr const_pointer getPointer(size_type index) const;
 
 	template< typename U >
-	iterator insert(U&& value);
-	void erase(size_type index);
+	constexpr iterator insert(U&& value);
+	constexpr void erase(size_type index);
+
+	template< typename F >
+	constexpr void forEach(F f) const;
+	template< typename F >
+	constexpr void drain(F& consumer);
 
   private:
-	size_type prepareInsert() noexcept;
-	void completeInsert(size_type index) noexcept;
+	constexpr size_type prepareInsert() noexcept;
+	constexpr void completeInsert(size_type index) noexcept;
 
-	void reconnectData(size_type nextIndex, size_type prevIndex, size_type nextValue, size_type prevValue) noexcept;
+	constexpr void reconnectData(size_type nextIndex, size_type prevIndex, size_type nextValue, size_type prevValue) noexcept;
+	constexpr void allocate();
+	constexpr void deallocate() noexcept;
+	void touch() noexcept;
+	[[nodiscard]] static constexpr bool isPaged(size_type bytes) noexcept;
+	[[nodiscard]] static constexpr size_type slabAlignment(size_type bytes, size_type natural) noexcept;
+	[[nodiscard]] static size_type advisePages(void* memory, size_type bytes) noexcept;
 
 	template< typename U >
-	[[nodiscard]] U* allocateMemory(size_type count) const;
+	[[nodiscard]] constexpr U* allocateMemory(size_type count) const;
+	template< typename U >
+	constexpr void releaseMemory(U*& memory) const noexcept;
+#ifdef BUCKET_STORAGE_GENERATIONS
+	[[nodiscard]] static uint64_t nextStamp() noexcept;
+#endif
 };
 
 // ------------------------------------------
@@ -197,32 +482,137 @@ class BucketStorage< T >::AbstractIterator
   private:
 	Bucket* bucket;
 	size_type index;
+#ifdef BUCKET_STORAGE_GENERATIONS
+	size_type record = 0;
+	uint64_t stamp = 0;
+	generation_type generation = 0;
+#endif
 
   public:
 	AbstractIterator() = default;
-	AbstractIterator(const AbstractIterator& other);
+	constexpr AbstractIterator(const AbstractIterator& other);
 	~AbstractIterator() = default;
 
-	AbstractIterator& operator=(const AbstractIterator& other);
-	AbstractIterator operator++(int);
-	AbstractIterator& operator++();
-	AbstractIterator operator--(int);
-	AbstractIterator& operator--();
-	bool operator==(const AbstractIterator< true >& other) const noexcept;
-	bool operator!=(const AbstractIterator< true >& other) const noexcept;
-	bool operator<=(const AbstractIterator< true >& other) const noexcept;
-	bool operator<(const AbstractIterator< true >& other) const noexcept;
-	bool operator>=(const AbstractIterator< true >& other) const noexcept;
-	bool operator>(const AbstractIterator< true >& other) const noexcept;
-	operator AbstractIterator< !IsConst >() const noexcept;
-	reference operator*() const;
-	pointer operator->() const;
-
-	AbstractIterator shiftNextBucket();
-	AbstractIterator shiftPrevBucket();
+	constexpr AbstractIterator& operator=(const AbstractIterator& other);
+	constexpr AbstractIterator operator++(int);
+	constexpr AbstractIterator& operator++();
+	constexpr AbstractIterator operator--(int);
+	constexpr AbstractIterator& operator--();
+	constexpr bool operator==(const AbstractIterator< true >& other) const noexcept;
+	constexpr bool operator!=(const AbstractIterator< true >& other) const noexcept;
+	constexpr bool operator<=(const AbstractIterator< true >& other) const noexcept;
+	constexpr bool operator<(const AbstractIterator< true >& other) const noexcept;
+	constexpr bool operator>=(const AbstractIterator< true >& other) const noexcept;
+	constexpr bool operator>(const AbstractIterator< true >& other) const noexcept;
+	constexpr operator AbstractIterator< !IsConst >() const noexcept;
+	constexpr reference operator*() const;
+	constexpr pointer operator->() const;
+
+	constexpr AbstractIterator shiftNextBucket();
+	constexpr AbstractIterator shiftPrevBucket();
 
   private:
-	AbstractIterator(Bucket* bucket, size_type index);
+	constexpr AbstractIterator(Bucket* bucket, size_type index);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	constexpr void capture() noexcept;
+#endif
+};
+
+// ------------------------------------------
+// START OF TRANSACTION INTERFACE
+// ------------------------------------------
+
+template< typename T >
+class BucketStorage< T >::Transaction
+{
+	BucketStorage< T >* storage;
+	id_type firstId;
+	std::unordered_map< id_type, iterator > inserted;
+	std::vector< T > erased;
+	bool pending;
+
+  public:
+	explicit Transaction(BucketStorage< T >& storage);
+	Transaction(const Transaction& other) = delete;
+	Transaction(Transaction&& other) noexcept;
+	~Transaction() noexcept;
+
+	Transaction& operator=(const Transaction& other) = delete;
+	Transaction& operator=(Transaction&& other) = delete;
+
+	template< typename U >
+	iterator insert(U&& value);
+	iterator erase(const_iterator it);
+
+	void commit() noexcept;
+	void rollback();
+	[[nodiscard]] bool active() const noexcept;
+};
+
+// ------------------------------------------
+// START OF BUCKET VIEW INTERFACE
+// ------------------------------------------
+
+template< typename T >
+class BucketStorage< T >::BucketView
+{
+	const Bucket* bucket;
+
+  public:
+	explicit BucketView(const Bucket* bucket) noexcept;
+
+	[[nodiscard]] size_type size() const noexcept;
+	[[nodiscard]] size_type capacity() const noexcept;
+	[[nodiscard]] id_type id() const noexcept;
+	[[nodiscard]] size_type owner() const noexcept;
+
+	template< typename F >
+	void for_each(F f) const;
+
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+};
+
+// ------------------------------------------
+// START OF FROZEN STORAGE INTERFACE
+// ------------------------------------------
+
+template< typename T >
+class BucketStorage< T >::FrozenStorage
+{
+	friend class BucketStorage;
+
+	std::vector< T > elements;
+	std::vector< size_type > bounds;
+	size_type blockCapacity;
+
+  public:
+	using value_type = T;
+	using const_reference = const T&;
+	using const_iterator = const T*;
+	using iterator = const_iterator;
+	using difference_type = std::ptrdiff_t;
+
+	explicit FrozenStorage(size_type block_capacity = DEFAULT_BLOCK_CAPACITY) noexcept;
+
+	[[nodiscard]] bool empty() const noexcept;
+	[[nodiscard]] size_type size() const noexcept;
+	[[nodiscard]] size_type bucket_count() const noexcept;
+	[[nodiscard]] size_type memory_usage() const noexcept;
+
+	const_reference operator[](size_type index) const noexcept;
+	const_reference at(size_type index) const;
+	[[nodiscard]] std::span< const T > bucket(size_type index) const;
+
+	[[nodiscard]] BucketStorage< T > thaw();
+
+	template< typename Make, typename Fold, typename Merge >
+	std::invoke_result_t< Make& > fold_buckets(Make make, Fold fold, Merge merge) const;
+
+	const_iterator begin() const noexcept;
+	const_iterator cbegin() const noexcept;
+	const_iterator end() const noexcept;
+	const_iterator cend() const noexcept;
 };
 
 // ------------------------------------------
@@ -230,226 +620,872 @@ class BucketStorage< T >::AbstractIterator
 // ------------------------------------------
 
 template< typename T >
-BucketStorage< T >::GeneralBucketContent::GeneralBucketContent(size_type blockCapacity) :
-	blockCapacity(blockCapacity), idCounter(0)
+constexpr BucketStorage< T >::GeneralBucketContent::GeneralBucketContent(size_type blockCapacity) :
+	blockCapacity(blockCapacity), idCounter(0), parallelism(1), stableOrder(false), threadAffinity(false), budget(nullptr),
+	overcommit(false), spareLimit(0), spareCapacity(0)
+{
+}
+template< typename T >
+constexpr BucketStorage< T >::GeneralBucketContent::GeneralBucketContent(const GeneralBucketContent& other) :
+	blockCapacity(other.blockCapacity), idCounter(other.idCounter), parallelism(other.parallelism),
+	stableOrder(other.stableOrder), threadAffinity(other.threadAffinity),
+	budget(other.budget == nullptr ? nullptr : new std::shared_ptr< MemoryBudget >(*other.budget)), overcommit(false),
+	spareLimit(0), spareCapacity(0)
 {
+	setSpareLimit(other.spareLimit);
+#ifdef BUCKET_STORAGE_TRACE
+	recorder = other.recorder;
+#endif
 }
 template< typename T >
-void BucketStorage< T >::GeneralBucketContent::setBlockCapacity(size_type value) noexcept
+constexpr BucketStorage< T >::GeneralBucketContent::~GeneralBucketContent()
+{
+	delete budget;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setBlockCapacity(size_type value) noexcept
 {
 	blockCapacity = value;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::GeneralBucketContent::getBlockCapacity() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::GeneralBucketContent::getBlockCapacity() const noexcept
 {
 	return blockCapacity;
 }
 template< typename T >
-BucketStorage< T >::id_type BucketStorage< T >::GeneralBucketContent::id() noexcept
+constexpr BucketStorage< T >::id_type BucketStorage< T >::GeneralBucketContent::id() noexcept
 {
 	return idCounter++;
 }
+template< typename T >
+constexpr BucketStorage< T >::id_type BucketStorage< T >::GeneralBucketContent::getIdCounter() const noexcept
+{
+	return idCounter;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::raiseIdCounter(id_type value) noexcept
+{
+	idCounter = std::max(idCounter, value);
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setParallelism(size_type value) noexcept
+{
+	parallelism = value;
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::GeneralBucketContent::getParallelism() const noexcept
+{
+	return parallelism;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setStableOrder(bool value) noexcept
+{
+	stableOrder = value;
+}
+template< typename T >
+constexpr bool BucketStorage< T >::GeneralBucketContent::getStableOrder() const noexcept
+{
+	return stableOrder;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setThreadAffinity(bool value) noexcept
+{
+	threadAffinity = value;
+}
+template< typename T >
+constexpr bool BucketStorage< T >::GeneralBucketContent::getThreadAffinity() const noexcept
+{
+	return threadAffinity;
+}
+template< typename T >
+constexpr std::vector< typename BucketStorage< T >::Bucket* >& BucketStorage< T >::GeneralBucketContent::getSpares() noexcept
+{
+	return spares;
+}
+template< typename T >
+constexpr const std::vector< typename BucketStorage< T >::Bucket* >& BucketStorage< T >::GeneralBucketContent::getSpares() const noexcept
+{
+	return spares;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setSpareLimit(size_type value)
+{
+	spares.reserve(value);
+	spareLimit = value;
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::GeneralBucketContent::getSpareLimit() const noexcept
+{
+	return spareLimit;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::addSpareCapacity(size_type value) noexcept
+{
+	spareCapacity += value;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::subtractSpareCapacity(size_type value) noexcept
+{
+	spareCapacity -= value;
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::GeneralBucketContent::getSpareCapacity() const noexcept
+{
+	return spareCapacity;
+}
+template< typename T >
+void BucketStorage< T >::GeneralBucketContent::setBudget(std::shared_ptr< MemoryBudget > value)
+{
+	if (!value)
+	{
+		delete std::exchange(budget, nullptr);
+		return;
+	}
+	if (budget == nullptr)
+		budget = new std::shared_ptr< MemoryBudget >(std::move(value));
+	else
+		*budget = std::move(value);
+}
+template< typename T >
+const std::shared_ptr< MemoryBudget >& BucketStorage< T >::GeneralBucketContent::getBudget() const noexcept
+{
+	static const std::shared_ptr< MemoryBudget > none;
+	return budget == nullptr ? none : *budget;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::charge(size_type bytes)
+{
+	if (budget != nullptr && overcommit)
+		(*budget)->force_charge(bytes);
+	else if (budget != nullptr)
+		(*budget)->charge(bytes);
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::forceCharge(size_type bytes) noexcept
+{
+	if (budget != nullptr)
+		(*budget)->force_charge(bytes);
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::release(size_type bytes) noexcept
+{
+	if (budget != nullptr)
+		(*budget)->release(bytes);
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setOvercommit(bool value) noexcept
+{
+	overcommit = value;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::makeRoom(size_type bytes)
+{
+	if (budget != nullptr)
+		(*budget)->make_room(bytes);
+}
+template< typename T >
+constexpr MemoryBudget::operation_scope BucketStorage< T >::GeneralBucketContent::deferTrims() const noexcept
+{
+	return MemoryBudget::operation_scope(budget == nullptr ? nullptr : budget->get());
+}
+#ifdef BUCKET_STORAGE_TRACE
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::setRecorder(TraceRecorder* value) noexcept
+{
+	recorder = value;
+}
+template< typename T >
+constexpr TraceRecorder* BucketStorage< T >::GeneralBucketContent::getRecorder() const noexcept
+{
+	return recorder;
+}
+#endif
+#ifdef BUCKET_STORAGE_GENERATIONS
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::reserveRecords(size_type count)
+{
+	if (count <= freeRecords.size())
+		return;
+
+	size_type total = stamps.size() + count - freeRecords.size();
+	freeRecords.reserve(total);
+	stamps.reserve(total);
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::GeneralBucketContent::enroll(uint64_t stamp)
+{
+	if (freeRecords.empty())
+	{
+		freeRecords.reserve(stamps.size() + 1);
+		stamps.push_back(stamp);
+		return stamps.size() - 1;
+	}
+	size_type record = freeRecords.back();
+	freeRecords.pop_back();
+	stamps[record] = stamp;
+	return record;
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::retire(size_type record) noexcept
+{
+	stamps[record] = 0;
+	freeRecords.push_back(record);
+}
+template< typename T >
+constexpr void BucketStorage< T >::GeneralBucketContent::retireAll() noexcept
+{
+	stamps.clear();
+	freeRecords.clear();
+}
+template< typename T >
+constexpr bool BucketStorage< T >::GeneralBucketContent::isLive(size_type record, uint64_t stamp) const noexcept
+{
+	return stamp != 0 && record < stamps.size() && stamps[record] == stamp;
+}
+#endif
+
+// ------------------------------------------
+// START OF ELEMENT HASH IMPLEMENTATION
+// ------------------------------------------
+
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::ElementHash::operator()(const T& value) const noexcept
+{
+	if constexpr (HAS_STD_HASH)
+		return std::hash< T >()(value);
+	else
+	{
+		static_assert(IS_BITWISE, "T must be hashable with std::hash or have unique object representations");
+
+		const auto* bytes = reinterpret_cast< const unsigned char* >(&value);
+		size_type result = sizeof(T);
+		size_type word = 0;
+		size_type offset = 0;
+		for (; offset + sizeof(size_type) <= sizeof(T); offset += sizeof(size_type))
+		{
+			std::memcpy(&word, bytes + offset, sizeof(size_type));
+			result = mix(result ^ word);
+		}
+		if (offset < sizeof(T))
+		{
+			word = 0;
+			std::memcpy(&word, bytes + offset, sizeof(T) - offset);
+			result = mix(result ^ word);
+		}
+		return result;
+	}
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::ElementHash::mix(size_type value) noexcept
+{
+	uint64_t result = value;
+	result = (result ^ (result >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	result = (result ^ (result >> 27)) * 0x94d049bb133111ebULL;
+	return static_cast< size_type >(result ^ (result >> 31));
+}
 
 // ------------------------------------------
 // START OF BUCKET STORAGE IMPLEMENTATION
 // ------------------------------------------
 
 template< typename T >
-BucketStorage< T >::BucketStorage() :
-	generalContent(GeneralBucketContent()), dataSize(0), blocksCount(0), first(new Bucket()), last(first), incomplete(last)
+constexpr BucketStorage< T >::BucketStorage() :
+	generalContent(createNode< GeneralBucketContent >()), first(createNode< Bucket >()), last(first), dataSize(0), blocksCount(0),
+	blocksCapacity(0), incomplete(last)
 {
 }
 template< typename T >
-BucketStorage< T >::BucketStorage(const BucketStorage< T >& other) :
-	generalContent(other.generalContent), dataSize(other.dataSize), blocksCount(other.blocksCount), first(new Bucket()),
-	last(first), incomplete(first)
+constexpr BucketStorage< T >::BucketStorage(const BucketStorage< T >& other) :
+	generalContent(createNode< GeneralBucketContent >(*other.generalContent)), first(createNode< Bucket >()), last(first),
+	dataSize(other.dataSize), blocksCount(other.blocksCount), blocksCapacity(other.blocksCapacity), incomplete(first)
 {
+#ifdef BUCKET_STORAGE_TRACE
+	generalContent->setRecorder(nullptr);
+#endif
 	if (!other.empty())
-		deepCopy(other);
+	{
+		auto deferred = generalContent->deferTrims();
+		try
+		{
+			deepCopy(other);
+		} catch (...)
+		{
+			cleanup();
+			throw;
+		}
+	}
 }
 template< typename T >
-BucketStorage< T >::BucketStorage(BucketStorage< T >&& other) noexcept :
-	generalContent(other.generalContent), dataSize(other.dataSize), blocksCount(other.blocksCount), first(other.first),
-	last(other.last), incomplete(other.incomplete)
+constexpr BucketStorage< T >::BucketStorage(BucketStorage< T >&& other) noexcept :
+	generalContent(other.generalContent), first(other.first), last(other.last), dataSize(other.dataSize),
+	blocksCount(other.blocksCount), blocksCapacity(other.blocksCapacity), incomplete(other.incomplete)
 {
 	other.resetPointers();
 }
 template< typename T >
-BucketStorage< T >::BucketStorage(size_type block_capacity) :
-	generalContent(block_capacity), dataSize(0), blocksCount(0), first(new Bucket()), last(first), incomplete(first)
+constexpr BucketStorage< T >::BucketStorage(size_type block_capacity) :
+	generalContent(createNode< GeneralBucketContent >(block_capacity)), first(createNode< Bucket >()), last(first), dataSize(0),
+	blocksCount(0), blocksCapacity(0), incomplete(first)
 {
 	if (block_capacity == 0)
 	{
-		generalContent.setBlockCapacity(DEFAULT_BLOCK_CAPACITY);
+		destroyNode(first);
+		destroyNode(generalContent);
 		throw std::invalid_argument("block_capacity cannot be zero");
 	}
 }
 template< typename T >
-BucketStorage< T >::~BucketStorage() noexcept
+constexpr BucketStorage< T >::~BucketStorage() noexcept
 {
+#ifdef BUCKET_STORAGE_TRACE
+	if (generalContent != nullptr)
+		generalContent->setRecorder(nullptr);
+#endif
 	cleanup();
 	resetPointers();
 }
 template< typename T >
-BucketStorage< T >& BucketStorage< T >::operator=(const BucketStorage< T >& other)
+constexpr BucketStorage< T >& BucketStorage< T >::operator=(const BucketStorage< T >& other)
 {
 	if (this == &other)
 		return *this;
 
 	BucketStorage temp(other);
+#ifdef BUCKET_STORAGE_TRACE
+	TraceRecorder* recorder = generalContent->getRecorder();
+	generalContent->setRecorder(nullptr);
+#endif
 	(*this).swap(temp);
+#ifdef BUCKET_STORAGE_TRACE
+	if (recorder != nullptr)
+	{
+		if (!temp.empty())
+			recorder->clear();
+		generalContent->setRecorder(recorder);
+		traceResync();
+	}
+#endif
 	return *this;
 }
 template< typename T >
-void BucketStorage< T >::deepCopy(const BucketStorage< T >& other)
+constexpr void BucketStorage< T >::deepCopy(const BucketStorage< T >& other)
 {
-	for (auto it = --other.end(); it != other.begin(); it.shiftPrevBucket())
+#ifdef BUCKET_STORAGE_GENERATIONS
+	generalContent->reserveRecords(other.blocksCount);
+#endif
+	size_type threads = threadsFor(other.blocksCount);
+	if (threads < 2)
+	{
+		for (const Bucket* bucket = other.last->getPrev(); bucket != nullptr; bucket = bucket->getPrev())
+		{
+			first = createNode< Bucket >(*bucket, generalContent, first, nullptr);
+#ifdef BUCKET_STORAGE_GENERATIONS
+			first->enroll();
+#endif
+			if (!first->isFull())
+				pushIncomplete(first);
+		}
+		return;
+	}
+
+	std::vector< const Bucket* > sources;
+	sources.reserve(other.blocksCount);
+	for (const Bucket* bucket = other.first; !bucket->isEnd(); bucket = bucket->getNext())
+		sources.push_back(bucket);
+
+	std::vector< Bucket* > copies(sources.size(), nullptr);
+	std::vector< std::exception_ptr > errors(threads);
+	std::vector< size_type > bounds = chunkBounds(sources, threads);
+	runChunks(
+		threads,
+		[&](size_type chunk)
+		{
+			try
+			{
+				for (size_type i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+				{
+					copies[i] = createNode< Bucket >(*sources[i], generalContent, nullptr, nullptr);
+					if (generalContent->getThreadAffinity())
+						copies[i]->setOwner(sources[i]->getOwner());
+				}
+			} catch (...)
+			{
+				errors[chunk] = std::current_exception();
+			}
+		});
+
+	for (const std::exception_ptr& error : errors)
 	{
-		first = new Bucket(*it.bucket, &generalContent, first, nullptr);
-		if (!first->isFull())
+		if (error)
 		{
-			incomplete->setPrevIncomplete(first);
-			first->setNextIncomplete(incomplete);
-			incomplete = first;
+			for (Bucket* copy : copies)
+				destroyNode(copy);
+			std::rethrow_exception(error);
 		}
 	}
+
+	for (size_type i = copies.size(); i-- > 0;)
+	{
+		copies[i]->setNext(i + 1 < copies.size() ? copies[i + 1] : last);
+		copies[i]->setPrev(i > 0 ? copies[i - 1] : nullptr);
+#ifdef BUCKET_STORAGE_GENERATIONS
+		copies[i]->enroll();
+#endif
+		if (!copies[i]->isFull())
+			pushIncomplete(copies[i]);
+	}
+	last->setPrev(copies.back());
+	first = copies.front();
 }
 template< typename T >
-BucketStorage< T >& BucketStorage< T >::operator=(BucketStorage< T >&& other) noexcept
+constexpr BucketStorage< T >& BucketStorage< T >::operator=(BucketStorage< T >&& other) noexcept
 {
 	if (this == &other)
 		return *this;
 
+#ifdef BUCKET_STORAGE_TRACE
+	TraceRecorder* recorder = generalContent == nullptr ? nullptr : generalContent->getRecorder();
+#endif
 	cleanup();
 	resetPointers();
 	other.swap(*this);
+#ifdef BUCKET_STORAGE_TRACE
+	if (generalContent != nullptr)
+	{
+		generalContent->setRecorder(recorder);
+		if (recorder != nullptr)
+			traceResync();
+	}
+#endif
 	return *this;
 }
 template< typename T >
-void BucketStorage< T >::prepareInsert()
+constexpr void BucketStorage< T >::makeRoomForInsert()
+{
+	if (!generalContent->getSpares().empty())
+		return;
+
+	Bucket* tail = last->getPrev();
+	if (generalContent->getStableOrder() ? tail == nullptr || tail->isFull() : incomplete->isEnd())
+		generalContent->makeRoom(Bucket::footprint(generalContent->getBlockCapacity()));
+}
+template< typename T >
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::prepareInsert()
 {
+	BUCKET_STORAGE_MEASURE(Allocation);
+	if (generalContent->getStableOrder())
+	{
+		Bucket* tail = last->getPrev();
+		if (tail != nullptr && !tail->isFull())
+			return tail;
+
+		Bucket* bucket = appendBucket();
+		pushIncomplete(bucket);
+		return bucket;
+	}
 	if (incomplete->isEnd())
 	{
-		incomplete = new Bucket(&generalContent, last, last->getPrev(), last);
+		incomplete = newBucket(last, last->getPrev(), last);
 		if (empty())
 			first = incomplete;
 		++blocksCount;
+		blocksCapacity += incomplete->getCapacity();
 	}
+	return incomplete;
 }
 template< typename T >
-void BucketStorage< T >::completeInsert()
+constexpr void BucketStorage< T >::completeInsert(Bucket* target)
 {
-	if (incomplete->isFull())
+	BUCKET_STORAGE_MEASURE(LinkMaintenance);
+	if (target->isFull())
 	{
-		incomplete = incomplete->getNextIncomplete();
-		incomplete->getPrevIncomplete()->setNextIncomplete(nullptr);
-		incomplete->setPrevIncomplete(nullptr);
+		if (target == incomplete)
+		{
+			incomplete = incomplete->getNextIncomplete();
+			incomplete->getPrevIncomplete()->setNextIncomplete(nullptr);
+			incomplete->setPrevIncomplete(nullptr);
+		}
+		else
+			unlinkIncomplete(target);
 	}
 	++dataSize;
 }
 template< typename T >
-void BucketStorage< T >::undoInsert()
+constexpr void BucketStorage< T >::undoInsert(Bucket* target)
 {
-	if (incomplete->isEmpty())
-	{
-		Bucket* temp = incomplete->getPrev();
-		last->setPrevIncomplete(nullptr);
-		last->setPrev(temp);
-		if (temp != nullptr)
-			temp->setNext(last);
-		delete incomplete;
-		incomplete = last;
-		--blocksCount;
-	}
+	if (target != nullptr && target->isEmpty())
+		releaseBucket(target);
 }
 template< typename T >
-template< typename U >
-BucketStorage< T >::iterator BucketStorage< T >::insert(U&& value)
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::appendBucket()
 {
-	try
-	{
-		prepareInsert();
-		auto it = incomplete->insert(std::forward< U >(value));
-		completeInsert();
-		return it;
-	} catch (...)
-	{
-		undoInsert();
-		throw;
-	}
+	Bucket* bucket = newBucket(last, last->getPrev(), nullptr);
+	if (bucket->isBegin())
+		first = bucket;
+	++blocksCount;
+	blocksCapacity += bucket->getCapacity();
+	return bucket;
 }
 template< typename T >
-BucketStorage< T >::iterator BucketStorage< T >::erase(BucketStorage::const_iterator it)
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::newBucket(Bucket* next, Bucket* prev, Bucket* incomplete)
 {
-	iterator temp(it);
-	++temp;
+	std::vector< Bucket* >& spares = generalContent->getSpares();
+	if (spares.empty())
+		return createNode< Bucket >(generalContent, next, prev, incomplete);
+
+	Bucket* bucket = spares.back();
+	bucket->link(next, prev, incomplete);
+	spares.pop_back();
+	generalContent->subtractSpareCapacity(bucket->getCapacity());
+	return bucket;
+}
+template< typename T >
+bool BucketStorage< T >::parkBucket(Bucket* bucket) noexcept
+{
+	std::vector< Bucket* >& spares = generalContent->getSpares();
+	if (!bucket->isEmpty() || spares.size() >= std::min(generalContent->getSpareLimit(), spares.capacity()))
+		return false;
+
+	bucket->park();
+	spares.push_back(bucket);
+	generalContent->addSpareCapacity(bucket->getCapacity());
+	return true;
+}
+template< typename T >
+constexpr void BucketStorage< T >::releaseSpares() noexcept
+{
+	std::vector< Bucket* >& spares = generalContent->getSpares();
+	while (!spares.empty())
+	{
+		generalContent->subtractSpareCapacity(spares.back()->getCapacity());
+		destroyNode(spares.back());
+		spares.pop_back();
+	}
+}
+template< typename T >
+template< typename U >
+constexpr BucketStorage< T >::iterator BucketStorage< T >::insert(U&& value)
+{
+	auto deferred = generalContent->deferTrims();
+	makeRoomForInsert();
+	Bucket* target = nullptr;
+	try
+	{
+		BUCKET_STORAGE_MEASURE(Insert);
+		target = prepareInsert();
+		auto it = target->insert(std::forward< U >(value));
+		completeInsert(target);
+#ifdef BUCKET_STORAGE_TRACE
+		if (TraceRecorder* recorder = generalContent->getRecorder())
+			recorder->insert(it.bucket->getId(), it.bucket->getDataId(it.index));
+#endif
+		return it;
+	} catch (...)
+	{
+		undoInsert(target);
+		throw;
+	}
+}
+template< typename T >
+template< std::ranges::input_range R >
+constexpr void BucketStorage< T >::bulk_build_sorted(R&& range)
+{
+	auto deferred = generalContent->deferTrims();
+	Bucket* tail = nullptr;
+	try
+	{
+		for (auto&& value : range)
+		{
+			if (tail == nullptr || tail->isFull())
+				tail = appendBucket();
+			auto it = tail->insert(std::forward< decltype(value) >(value));
+			++dataSize;
+#ifdef BUCKET_STORAGE_TRACE
+			if (TraceRecorder* recorder = generalContent->getRecorder())
+				recorder->insert(it.bucket->getId(), it.bucket->getDataId(it.index));
+#else
+			static_cast< void >(it);
+#endif
+		}
+	} catch (...)
+	{
+		if (tail != nullptr && tail->isEmpty())
+			releaseBucket(tail);
+		else if (tail != nullptr && !tail->isFull())
+			pushIncomplete(tail);
+		throw;
+	}
+	if (tail != nullptr && !tail->isFull())
+		pushIncomplete(tail);
+}
+template< typename T >
+constexpr BucketStorage< T >::iterator BucketStorage< T >::erase(BucketStorage::const_iterator it)
+{
+	BUCKET_STORAGE_MEASURE(Erase);
+#ifdef BUCKET_STORAGE_TRACE
+	if (TraceRecorder* recorder = generalContent->getRecorder())
+		recorder->erase(it.bucket->getId(), it.bucket->getDataId(it.index));
+#endif
+	iterator temp(it);
+	++temp;
 
 	it.bucket->erase(it.index);
 	if (it.bucket->isEmpty())
+		releaseBucket(it.bucket);
+	else if (it.bucket->getSize() == it.bucket->getCapacity() - 1)
+		pushIncomplete(it.bucket);
+	--dataSize;
+	return temp;
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::erase_batch(std::span< const const_iterator > its)
+{
+	for (size_type i = 0; i < its.size(); ++i)
 	{
-		Bucket* next = it.bucket->getNext();
-		Bucket* prev = it.bucket->getPrev();
-		Bucket* nextIncomplete = it.bucket->getNextIncomplete();
-		Bucket* prevIncomplete = it.bucket->getPrevIncomplete();
+		if (i + 2 * ERASE_PREFETCH_DISTANCE < its.size())
+			prefetchForWrite(its[i + 2 * ERASE_PREFETCH_DISTANCE].bucket);
+		if (i + ERASE_PREFETCH_DISTANCE < its.size())
+			its[i + ERASE_PREFETCH_DISTANCE].bucket->prefetchSlot(its[i + ERASE_PREFETCH_DISTANCE].index);
+
+		Bucket* bucket = its[i].bucket;
+#ifdef BUCKET_STORAGE_TRACE
+		if (TraceRecorder* recorder = generalContent->getRecorder())
+			recorder->erase(bucket->getId(), bucket->getDataId(its[i].index));
+#endif
+		bucket->erase(its[i].index);
+		if (bucket->isEmpty())
+			releaseBucket(bucket);
+		else if (bucket->getSize() == bucket->getCapacity() - 1)
+			pushIncomplete(bucket);
+	}
+	dataSize -= its.size();
+	return its.size();
+}
+template< typename T >
+constexpr void BucketStorage< T >::pushIncomplete(Bucket* bucket) noexcept
+{
+	BUCKET_STORAGE_MEASURE(LinkMaintenance);
+	incomplete->setPrevIncomplete(bucket);
+	bucket->setNextIncomplete(incomplete);
+	incomplete = bucket;
+}
+template< typename T >
+constexpr void BucketStorage< T >::releaseBucket(Bucket* bucket) noexcept
+{
+	BUCKET_STORAGE_MEASURE(Deallocation);
+	detachBucket(bucket);
+	if (std::is_constant_evaluated() || !parkBucket(bucket))
+		destroyNode(bucket);
+}
+template< typename T >
+constexpr void BucketStorage< T >::detachBucket(Bucket* bucket) noexcept
+{
+	Bucket* next = bucket->getNext();
+	Bucket* prev = bucket->getPrev();
 
-		next->setPrev(prev);
-		if (prev != nullptr)
-			prev->setNext(next);
-		else
-			first = next;
+	next->setPrev(prev);
+	if (prev != nullptr)
+		prev->setNext(next);
+	else
+		first = next;
 
-		if (nextIncomplete != nullptr)
-			nextIncomplete->setPrevIncomplete(prevIncomplete);
-		if (prevIncomplete != nullptr)
-			prevIncomplete->setNextIncomplete(nextIncomplete);
-		else if (incomplete == it.bucket)
-			incomplete = nextIncomplete;
+	unlinkIncomplete(bucket);
+	bucket->setNext(nullptr);
+	bucket->setPrev(nullptr);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket->retire();
+#endif
 
-		delete it.bucket;
-		--blocksCount;
-	}
-	else if (it.bucket->getSize() == generalContent.getBlockCapacity() - 1)
+	dataSize -= bucket->getSize();
+	--blocksCount;
+	blocksCapacity -= bucket->getCapacity();
+}
+template< typename T >
+constexpr void BucketStorage< T >::unlinkIncomplete(Bucket* bucket) noexcept
+{
+	Bucket* nextIncomplete = bucket->getNextIncomplete();
+	Bucket* prevIncomplete = bucket->getPrevIncomplete();
+
+	if (nextIncomplete != nullptr)
+		nextIncomplete->setPrevIncomplete(prevIncomplete);
+	if (prevIncomplete != nullptr)
+		prevIncomplete->setNextIncomplete(nextIncomplete);
+	else if (incomplete == bucket)
+		incomplete = nextIncomplete;
+
+	bucket->setNextIncomplete(nullptr);
+	bucket->setPrevIncomplete(nullptr);
+}
+template< typename T >
+void BucketStorage< T >::compactBucket(Bucket* bucket)
+{
+	unlinkIncomplete(bucket);
+	size_type size = bucket->getSize();
+	auto consumer = [this](T&& value) { insert(std::move(value)); };
+	try
+	{
+		bucket->drain(consumer);
+	} catch (...)
 	{
-		incomplete->setPrevIncomplete(it.bucket);
-		it.bucket->setNextIncomplete(incomplete);
-		incomplete = it.bucket;
+		dataSize -= size - bucket->getSize();
+		if (bucket->isEmpty())
+			releaseBucket(bucket);
+		else
+			pushIncomplete(bucket);
+		throw;
 	}
-	--dataSize;
-	return temp;
+	dataSize -= size;
+	releaseBucket(bucket);
+}
+template< typename T >
+void BucketStorage< T >::adoptBucket(Bucket* bucket) noexcept
+{
+	Bucket* prev = last->getPrev();
+
+	bucket->rebind(generalContent);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket->enroll();
+#endif
+	bucket->setPrev(prev);
+	bucket->setNext(last);
+	if (prev != nullptr)
+		prev->setNext(bucket);
+	else
+		first = bucket;
+	last->setPrev(bucket);
+
+	if (!bucket->isFull())
+		pushIncomplete(bucket);
+
+	dataSize += bucket->getSize();
+	++blocksCount;
+	blocksCapacity += bucket->getCapacity();
 }
 template< typename T >
-bool BucketStorage< T >::empty() const noexcept
+constexpr bool BucketStorage< T >::empty() const noexcept
 {
 	return dataSize == 0;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::size() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::size() const noexcept
 {
 	return dataSize;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::capacity() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::capacity() const noexcept
 {
-	return generalContent.getBlockCapacity() * blocksCount;
+	return blocksCapacity + generalContent->getSpareCapacity();
+}
+template< typename T >
+void BucketStorage< T >::reserve(size_type n)
+{
+	if (n <= capacity())
+		return;
+
+	auto deferred = generalContent->deferTrims();
+	size_type blockCapacity = generalContent->getBlockCapacity();
+	generalContent->makeRoom((n - capacity() + blockCapacity - 1) / blockCapacity * Bucket::footprint(blockCapacity));
+	if (n <= capacity())
+		return;
+
+	size_type count = (n - capacity() + blockCapacity - 1) / blockCapacity;
+	std::vector< Bucket* >& spares = generalContent->getSpares();
+	spares.reserve(spares.size() + count);
+	id_type base = generalContent->getIdCounter();
+	generalContent->raiseIdCounter(base + count);
+
+	std::vector< Bucket* > fresh(count, nullptr);
+	size_type threads = std::max< size_type >(threadsFor(count), 1);
+	bool owned = threads >= 2 && generalContent->getThreadAffinity();
+	std::vector< std::exception_ptr > errors(threads);
+	auto build = [&](size_type chunk)
+	{
+		try
+		{
+			for (size_type i = count * chunk / threads; i < count * (chunk + 1) / threads; ++i)
+			{
+				fresh[i] = createNode< Bucket >(generalContent, base + i);
+				if (owned)
+					fresh[i]->setOwner(chunk);
+			}
+		} catch (...)
+		{
+			errors[chunk] = std::current_exception();
+		}
+	};
+	if (threads < 2)
+		build(0);
+	else
+		runChunks(threads, build);
+
+	for (const std::exception_ptr& error : errors)
+	{
+		if (error)
+		{
+			for (Bucket* bucket : fresh)
+				destroyNode(bucket);
+			std::rethrow_exception(error);
+		}
+	}
+	for (size_type i = count; i-- > 0;)
+	{
+		spares.push_back(fresh[i]);
+		generalContent->addSpareCapacity(fresh[i]->getCapacity());
+	}
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::trim(std::chrono::milliseconds idle)
+{
+	std::chrono::steady_clock::time_point cutoff = std::chrono::steady_clock::now() - idle;
+	size_type bytes = 0;
+	for (Bucket* spare : generalContent->getSpares())
+		bytes += spare->advise(cutoff);
+	return bytes;
 }
 template< typename T >
 void BucketStorage< T >::shrink_to_fit()
 {
-	BucketStorage< T > temp(generalContent.getBlockCapacity());
+	BucketStorage< T > temp(generalContent->getBlockCapacity());
+	temp.set_memory_budget(generalContent->getBudget());
+	temp.set_thread_affinity(generalContent->getThreadAffinity());
+	temp.set_spare_limit(generalContent->getSpareLimit());
+	temp.set_parallelism(generalContent->getParallelism());
+	temp.set_stable_order(generalContent->getStableOrder());
 
+	auto deferred = generalContent->deferTrims();
 	for (auto it = begin(); it != end(); ++it)
 		temp.insert(std::move(*it));
 
+#ifdef BUCKET_STORAGE_TRACE
+	TraceRecorder* recorder = generalContent->getRecorder();
+	std::vector< TraceRecorder::key_type > from;
+	if (recorder != nullptr)
+	{
+		from = traceKeys();
+		generalContent->setRecorder(nullptr);
+	}
+#endif
+
 	*this = std::move(temp);
+
+#ifdef BUCKET_STORAGE_TRACE
+	if (recorder != nullptr)
+	{
+		generalContent->setRecorder(recorder);
+		recorder->shrinkToFit(from, traceKeys());
+	}
+#endif
 }
 template< typename T >
-void BucketStorage< T >::clear()
+constexpr void BucketStorage< T >::clear()
 {
 	if (!empty())
 	{
-		auto it = begin();
-		while (it != end())
-			delete it.shiftNextBucket().bucket;
+#ifdef BUCKET_STORAGE_TRACE
+		if (TraceRecorder* recorder = generalContent->getRecorder())
+			recorder->clear();
+#endif
+		destroyBuckets();
 
 		first = last;
 		incomplete = last;
@@ -459,16 +1495,164 @@ void BucketStorage< T >::clear()
 
 		dataSize = 0;
 		blocksCount = 0;
+		blocksCapacity = 0;
+	}
+}
+template< typename T >
+std::future< void > BucketStorage< T >::detach_destroy()
+{
+	auto doomed = std::make_unique< BucketStorage< T > >(generalContent->getBlockCapacity());
+	doomed->generalContent->setBudget(generalContent->getBudget());
+	doomed->generalContent->setParallelism(generalContent->getParallelism());
+	doomed->generalContent->setThreadAffinity(generalContent->getThreadAffinity());
+	doomed->generalContent->setSpareLimit(generalContent->getSpareLimit());
+#ifdef BUCKET_STORAGE_TRACE
+	if (TraceRecorder* recorder = generalContent->getRecorder())
+	{
+		if (!empty())
+			recorder->clear();
+		doomed->generalContent->setRecorder(recorder);
+		generalContent->setRecorder(nullptr);
+	}
+#endif
+	swap(*doomed);
+
+	try
+	{
+		return std::async(std::launch::async, [doomed = std::move(doomed)]() mutable { doomed.reset(); });
+	} catch (const std::system_error&)
+	{
+		std::promise< void > done;
+		done.set_value();
+		return done.get_future();
+	}
+}
+template< typename T >
+BucketStorage< T >::frozen_storage BucketStorage< T >::freeze()
+{
+	FrozenStorage result(generalContent->getBlockCapacity());
+	result.elements.reserve(dataSize);
+	result.bounds.reserve(blocksCount);
+	for (Bucket* bucket = first; !bucket->isEnd(); bucket = bucket->getNext())
+	{
+		for (auto it = iterator(bucket, bucket->getFirstIndex()); it.bucket == bucket; ++it)
+			result.elements.push_back(std::move(*it));
+		result.bounds.push_back(result.elements.size());
+	}
+
+	clear();
+	return result;
+}
+template< typename T >
+Generator< const T& > BucketStorage< T >::elements() const
+{
+	for (const T& value : *this)
+		co_yield value;
+}
+template< typename T >
+Generator< typename BucketStorage< T >::bucket_view > BucketStorage< T >::buckets() const
+{
+	for (const Bucket* bucket = first; !bucket->isEnd(); bucket = bucket->getNext())
+		co_yield BucketView(bucket);
+}
+template< typename T >
+MaintenanceTask BucketStorage< T >::co_compact(size_type buckets_per_step)
+{
+	size_type processed = 0;
+	while (true)
+	{
+		std::vector< Bucket* > sparse;
+		size_type free = 0;
+		for (Bucket* bucket = incomplete; !bucket->isEnd(); bucket = bucket->getNextIncomplete())
+		{
+			sparse.push_back(bucket);
+			free += bucket->getCapacity() - bucket->getSize();
+		}
+		std::sort(sparse.begin(),
+				  sparse.end(),
+				  [](const Bucket* first, const Bucket* second) { return first->getSize() < second->getSize(); });
+
+		size_type moved = 0;
+		{
+			auto deferred = generalContent->deferTrims();
+			for (Bucket* bucket : sparse)
+			{
+				if (bucket->isFull() || (generalContent->getStableOrder() && bucket == last->getPrev()))
+					continue;
+
+				free -= bucket->getCapacity() - bucket->getSize();
+				if (moved == buckets_per_step || free < bucket->getSize())
+					break;
+
+				free -= bucket->getSize();
+				compactBucket(bucket);
+				++moved;
+			}
+		}
+#ifdef BUCKET_STORAGE_TRACE
+		traceResync();
+#endif
+		if (moved == 0)
+			co_return;
+
+		processed += moved;
+		co_yield processed;
+	}
+}
+template< typename T >
+MaintenanceTask BucketStorage< T >::co_clear(size_type buckets_per_step)
+{
+	size_type processed = 0;
+	while (!empty())
+	{
+		for (size_type i = 0; i < buckets_per_step && !empty(); ++i, ++processed)
+			releaseBucket(first);
+#ifdef BUCKET_STORAGE_TRACE
+		traceResync();
+#endif
+		co_yield processed;
 	}
 }
 template< typename T >
-void BucketStorage< T >::swap(BucketStorage< T >& other) noexcept
+MaintenanceTask BucketStorage< T >::co_copy(BucketStorage< T >& target, size_type buckets_per_step) const
+{
+	size_type processed = 0;
+	id_type copiedId = 0;
+	const Bucket* bucket = first;
+	while (!bucket->isEnd())
+	{
+		target.generalContent->raiseIdCounter(generalContent->getIdCounter());
+		{
+			auto deferred = target.generalContent->deferTrims();
+			for (size_type i = 0; i < buckets_per_step && !bucket->isEnd(); ++i, ++processed)
+			{
+#ifdef BUCKET_STORAGE_GENERATIONS
+				target.generalContent->reserveRecords(1);
+#endif
+				target.adoptBucket(createNode< Bucket >(*bucket, target.generalContent, nullptr, nullptr));
+				copiedId = bucket->getId();
+				bucket = bucket->getNext();
+			}
+		}
+#ifdef BUCKET_STORAGE_TRACE
+		target.traceResync();
+#endif
+		co_yield processed;
+
+		bucket = first;
+		while (!bucket->isEnd() && bucket->getId() <= copiedId)
+			bucket = bucket->getNext();
+	}
+}
+template< typename T >
+constexpr void BucketStorage< T >::swap(BucketStorage< T >& other) noexcept
 {
 	using std::swap;
 
 	swap(generalContent, other.generalContent);
 	swap(dataSize, other.dataSize);
 	swap(blocksCount, other.blocksCount);
+	swap(blocksCapacity, other.blocksCapacity);
 	swap(first, other.first);
 	swap(last, other.last);
 	swap(incomplete, other.incomplete);
@@ -479,7 +1663,7 @@ void swap(BucketStorage< T >& first, BucketStorage< T >& second) noexcept
 	first.swap(second);
 }
 template< typename T >
-BucketStorage< T >::iterator BucketStorage< T >::get_to_distance(BucketStorage::iterator it, BucketStorage::difference_type distance)
+constexpr BucketStorage< T >::iterator BucketStorage< T >::get_to_distance(BucketStorage::iterator it, BucketStorage::difference_type distance)
 {
 	while (distance > 0)
 	{
@@ -504,238 +1688,1000 @@ BucketStorage< T >::iterator BucketStorage< T >::get_to_distance(BucketStorage::
 	return it;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::max_size() const noexcept
+template< typename Hash >
+BucketStorage< T >::size_type BucketStorage< T >::content_hash(Hash hash) const
+{
+#ifdef BUCKET_STORAGE_TRACE
+	if (TraceRecorder* recorder = generalContent->getRecorder())
+		recorder->scan();
+#endif
+	size_type sum = reduceBuckets(
+		size_type(0),
+		[&hash](const Bucket& bucket)
+		{
+			size_type result = 0;
+			bucket.forEach([&hash, &result](const T& value) { result += ElementHash::mix(hash(value)); });
+			return result;
+		},
+		std::plus< size_type >());
+	return ElementHash::mix(sum ^ dataSize);
+}
+template< typename T >
+template< typename F >
+void BucketStorage< T >::drain(F consumer)
+{
+	while (!empty())
+	{
+		Bucket* bucket = first;
+		size_type size = bucket->getSize();
+#ifdef BUCKET_STORAGE_TRACE
+		if (TraceRecorder* recorder = generalContent->getRecorder())
+			for (auto it = begin(); it.bucket == bucket; ++it)
+				recorder->erase(bucket->getId(), bucket->getDataId(it.index));
+#endif
+		try
+		{
+			bucket->drain(consumer);
+		} catch (...)
+		{
+			dataSize -= size - bucket->getSize();
+			if (size == bucket->getCapacity() && !bucket->isFull())
+				pushIncomplete(bucket);
+#ifdef BUCKET_STORAGE_TRACE
+			traceResync();
+#endif
+			throw;
+		}
+		dataSize -= size;
+		releaseBucket(bucket);
+	}
+}
+template< typename T >
+void BucketStorage< T >::drain_into(BucketStorage< T >& other)
+{
+	other.merge(*this);
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::merge(BucketStorage< T >& other)
+{
+	if (this == &other || other.empty())
+		return 0;
+
+	auto deferred = generalContent->deferTrims();
+	generalContent->raiseIdCounter(other.generalContent->getIdCounter());
+#ifdef BUCKET_STORAGE_GENERATIONS
+	generalContent->reserveRecords(other.blocksCount);
+#endif
+
+	Bucket* bucket = other.first;
+	while (!bucket->isEnd())
+	{
+		Bucket* next = bucket->getNext();
+		if (bucket->getCapacity() == generalContent->getBlockCapacity() || bucket->getSize() * 2 >= bucket->getCapacity())
+		{
+			other.detachBucket(bucket);
+			adoptBucket(bucket);
+		}
+		bucket = next;
+	}
+
+	size_type moves = 0;
+	other.drain(
+		[this, &moves](T&& value)
+		{
+			insert(std::move(value));
+			++moves;
+		});
+
+#ifdef BUCKET_STORAGE_TRACE
+	traceResync();
+	other.traceResync();
+#endif
+	return moves;
+}
+template< typename T >
+void BucketStorage< T >::set_memory_budget(std::shared_ptr< MemoryBudget > budget)
+{
+	if (budget == generalContent->getBudget())
+		return;
+
+	for (Bucket* bucket = first; !bucket->isEnd(); bucket = bucket->getNext())
+	{
+		if (budget)
+			budget->force_charge(Bucket::footprint(bucket->getCapacity()));
+		generalContent->release(Bucket::footprint(bucket->getCapacity()));
+	}
+	for (const Bucket* bucket : generalContent->getSpares())
+	{
+		if (budget)
+			budget->force_charge(Bucket::footprint(bucket->getCapacity()));
+		generalContent->release(Bucket::footprint(bucket->getCapacity()));
+	}
+	generalContent->setBudget(std::move(budget));
+}
+template< typename T >
+const std::shared_ptr< MemoryBudget >& BucketStorage< T >::memory_budget() const noexcept
+{
+	return generalContent->getBudget();
+}
+template< typename T >
+void BucketStorage< T >::set_parallelism(size_type threads) noexcept
+{
+	generalContent->setParallelism(threads);
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::parallelism() const noexcept
+{
+	return generalContent->getParallelism();
+}
+template< typename T >
+constexpr void BucketStorage< T >::set_stable_order(bool enabled) noexcept
+{
+	generalContent->setStableOrder(enabled);
+}
+template< typename T >
+constexpr bool BucketStorage< T >::stable_order() const noexcept
+{
+	return generalContent->getStableOrder();
+}
+template< typename T >
+void BucketStorage< T >::set_thread_affinity(bool enabled) noexcept
+{
+	generalContent->setThreadAffinity(enabled);
+}
+template< typename T >
+bool BucketStorage< T >::thread_affinity() const noexcept
+{
+	return generalContent->getThreadAffinity();
+}
+template< typename T >
+void BucketStorage< T >::set_spare_limit(size_type buckets)
+{
+	generalContent->setSpareLimit(buckets);
+	std::vector< Bucket* >& spares = generalContent->getSpares();
+	if (spares.size() <= buckets)
+		return;
+
+	size_type excess = spares.size() - buckets;
+	for (size_type i = 0; i < excess; ++i)
+	{
+		generalContent->subtractSpareCapacity(spares[i]->getCapacity());
+		destroyNode(spares[i]);
+	}
+	spares.erase(spares.begin(), spares.begin() + excess);
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::spare_limit() const noexcept
+{
+	return generalContent->getSpareLimit();
+}
+#ifdef BUCKET_STORAGE_GENERATIONS
+template< typename T >
+bool BucketStorage< T >::valid(const_iterator it) const noexcept
+{
+	return generalContent->isLive(it.record, it.stamp) && it.bucket->getGeneration(it.index) == it.generation;
+}
+#endif
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::bytes_for(size_type n, size_type block_capacity) noexcept
+{
+	size_type buckets = block_capacity == 0 ? 0 : (n + block_capacity - 1) / block_capacity;
+	return sizeof(BucketStorage< T >) + sizeof(GeneralBucketContent) + sizeof(Bucket) + buckets * Bucket::footprint(block_capacity);
+}
+template< typename T >
+template< typename BucketStorage< T >::size_type N >
+constexpr std::array< T, N > BucketStorage< T >::to_array() const
+{
+	if (size() != N)
+		throw std::length_error("size does not match the array extent");
+
+	auto it = begin();
+	return [&]< size_type... I >(std::index_sequence< I... >) { return std::array< T, N >{ (void(I), *it++)... }; }(
+		std::make_index_sequence< N >());
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::memory_usage() const
+{
+	size_type fixed = sizeof(BucketStorage< T >) + allocationSize(generalContent, sizeof(GeneralBucketContent)) +
+					  allocationSize(last, sizeof(Bucket));
+	for (const Bucket* spare : generalContent->getSpares())
+		fixed += spare->memoryUsage();
+	return reduceBuckets(
+		fixed,
+		[](const Bucket& bucket) { return bucket.memoryUsage(); },
+		[](size_type result, size_type usage) { return result + usage; });
+}
+#ifdef BUCKET_STORAGE_TRACE
+template< typename T >
+void BucketStorage< T >::set_trace_recorder(TraceRecorder* recorder)
+{
+	generalContent->setRecorder(recorder);
+	if (recorder != nullptr)
+	{
+		recorder->start(sizeof(T), generalContent->getBlockCapacity());
+		recorder->resync(traceKeys());
+	}
+}
+template< typename T >
+std::vector< TraceRecorder::key_type > BucketStorage< T >::traceKeys() const
+{
+	std::vector< TraceRecorder::key_type > keys;
+	keys.reserve(dataSize);
+	for (auto it = begin(); it != end(); ++it)
+		keys.emplace_back(it.bucket->getId(), it.bucket->getDataId(it.index));
+	return keys;
+}
+template< typename T >
+void BucketStorage< T >::traceResync() const
+{
+	if (TraceRecorder* recorder = generalContent->getRecorder())
+		recorder->resync(traceKeys());
+}
+#endif
+template< typename T >
+bool equal_unordered(const BucketStorage< T >& first, const BucketStorage< T >& second)
+{
+	using ElementHash = typename BucketStorage< T >::ElementHash;
+	using size_type = typename BucketStorage< T >::size_type;
+
+	if (&first == &second)
+		return true;
+	if (first.size() != second.size())
+		return false;
+	if (first.empty())
+		return true;
+
+	if constexpr (ElementHash::IS_BITWISE && (std::is_scalar_v< T > || !std::equality_comparable< T >))
+	{
+		if (first.content_hash() != second.content_hash())
+			return false;
+
+		auto less = [](const T& lhs, const T& rhs) { return std::memcmp(&lhs, &rhs, sizeof(T)) < 0; };
+		std::vector< T > lhs(first.begin(), first.end());
+		std::vector< T > rhs(second.begin(), second.end());
+		std::sort(lhs.begin(), lhs.end(), less);
+		std::sort(rhs.begin(), rhs.end(), less);
+		return std::memcmp(lhs.data(), rhs.data(), sizeof(T) * lhs.size()) == 0;
+	}
+	else if constexpr (ElementHash::HAS_STD_HASH)
+	{
+		if (first.content_hash() != second.content_hash())
+			return false;
+
+		auto hash = [](const T* value) { return ElementHash()(*value); };
+		auto equal = [](const T* lhs, const T* rhs) { return *lhs == *rhs; };
+		std::unordered_map< const T*, size_type, decltype(hash), decltype(equal) > counts(first.size(), hash, equal);
+		for (const T& value : first)
+			++counts[&value];
+		for (const T& value : second)
+		{
+			auto found = counts.find(&value);
+			if (found == counts.end() || found->second == 0)
+				return false;
+			--found->second;
+		}
+		return true;
+	}
+	else
+		return std::is_permutation(first.begin(), first.end(), second.begin(), second.end());
+}
+template< auto Build >
+constexpr auto materialize_storage()
+{
+	constexpr std::size_t size = Build().size();
+	return Build().template to_array< size >();
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::max_size() const noexcept
+{
+	return std::numeric_limits< size_type >::max() / sizeof(T);
+}
+template< typename T >
+constexpr BucketStorage< T >::iterator BucketStorage< T >::begin() noexcept
+{
+	return iterator(first, first->getFirstIndex());
+}
+template< typename T >
+constexpr BucketStorage< T >::const_iterator BucketStorage< T >::begin() const noexcept
+{
+	return const_iterator(first, first->getFirstIndex());
+}
+template< typename T >
+constexpr BucketStorage< T >::const_iterator BucketStorage< T >::cbegin() const noexcept
+{
+	return const_iterator(first, first->getFirstIndex());
+}
+template< typename T >
+constexpr BucketStorage< T >::iterator BucketStorage< T >::end() noexcept
+{
+	return iterator(last, 0);
+}
+template< typename T >
+constexpr BucketStorage< T >::const_iterator BucketStorage< T >::end() const noexcept
+{
+	return const_iterator(last, 0);
+}
+template< typename T >
+constexpr BucketStorage< T >::const_iterator BucketStorage< T >::cend() const noexcept
+{
+	return const_iterator(last, 0);
+}
+template< typename T >
+constexpr void BucketStorage< T >::resetPointers()
+{
+	generalContent = nullptr;
+	first = nullptr;
+	last = nullptr;
+	incomplete = nullptr;
+	dataSize = 0;
+	blocksCount = 0;
+	blocksCapacity = 0;
+}
+template< typename T >
+constexpr void BucketStorage< T >::cleanup()
+{
+	clear();
+	if (generalContent != nullptr)
+		releaseSpares();
+	destroyNode(last);
+	destroyNode(generalContent);
+}
+template< typename T >
+template< typename U, typename... Args >
+constexpr U* BucketStorage< T >::createNode(Args&&... args)
+{
+	if (std::is_constant_evaluated())
+		return new U(std::forward< Args >(args)...);
+
+	void* memory = SlabCache::local().acquire(sizeof(U), alignof(U), 1);
+	try
+	{
+		return ::new (memory) U(std::forward< Args >(args)...);
+	} catch (...)
+	{
+		SlabCache::local().release(memory, sizeof(U), alignof(U), 1);
+		throw;
+	}
+}
+template< typename T >
+template< typename U >
+constexpr void BucketStorage< T >::destroyNode(U* node) noexcept
+{
+	if (std::is_constant_evaluated())
+	{
+		delete node;
+		return;
+	}
+	if (node == nullptr)
+		return;
+
+	std::destroy_at(node);
+	SlabCache::local().release(node, sizeof(U), alignof(U), 1);
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::allocationSize(const void* pointer, size_type requested) noexcept
+{
+#if defined(__GLIBC__)
+	if (pointer != nullptr)
+		return malloc_usable_size(const_cast< void* >(pointer)) + sizeof(size_type);
+#endif
+	return pointer == nullptr ? 0 : requested;
+}
+template< typename T >
+void BucketStorage< T >::prefetchForWrite(const void* address) noexcept
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(address, 1);
+#else
+	static_cast< void >(address);
+#endif
+}
+template< typename T >
+constexpr void BucketStorage< T >::destroyBuckets() noexcept
+{
+#ifdef BUCKET_STORAGE_GENERATIONS
+	generalContent->retireAll();
+#endif
+	size_type threads = threadsFor(blocksCount);
+	std::vector< Bucket* > buckets;
+	std::vector< size_type > bounds;
+	if (threads >= 2)
+	{
+		try
+		{
+			buckets.reserve(blocksCount);
+			for (Bucket* bucket = first; !bucket->isEnd(); bucket = bucket->getNext())
+				buckets.push_back(bucket);
+			bounds = chunkBounds(buckets, threads);
+		} catch (const std::bad_alloc&)
+		{
+			threads = 1;
+		}
+	}
+	if (threads < 2)
+	{
+		auto it = begin();
+		while (it != end())
+			destroyNode(it.shiftNextBucket().bucket);
+		return;
+	}
+
+	runChunks(
+		threads,
+		[&](size_type chunk)
+		{
+			for (size_type i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+				destroyNode(buckets[i]);
+		});
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::threadsFor(size_type buckets) const noexcept
+{
+	if (std::is_constant_evaluated())
+		return 1;
+
+	size_type limit = generalContent->getParallelism();
+	if (limit == 0)
+		limit = std::thread::hardware_concurrency();
+	return std::min< size_type >(limit, buckets / PARALLEL_BUCKET_THRESHOLD);
+}
+template< typename T >
+template< typename R, typename Map, typename Reduce >
+R BucketStorage< T >::reduce_buckets(R init, Map map, Reduce reduce) const
+{
+	return reduceBuckets(
+		std::move(init), [&map](const Bucket& bucket) { return map(bucket_view(&bucket)); }, reduce);
+}
+template< typename T >
+template< typename Make, typename Fold, typename Merge >
+std::invoke_result_t< Make& > BucketStorage< T >::fold_buckets(Make make, Fold fold, Merge merge) const
+{
+	return foldBuckets(
+		make, [&fold](auto& result, const Bucket& bucket) { fold(result, bucket_view(&bucket)); }, merge);
+}
+template< typename T >
+template< typename R, typename Map, typename Reduce >
+R BucketStorage< T >::reduceBuckets(R init, Map map, Reduce reduce) const
+{
+	std::optional< R > result = foldBuckets(
+		[] { return std::optional< R >(); },
+		[&map, &reduce](std::optional< R >& result, const Bucket& bucket)
+		{
+			if (result)
+				result.emplace(reduce(std::move(*result), map(bucket)));
+			else
+				result.emplace(map(bucket));
+		},
+		[&reduce](std::optional< R > first, std::optional< R > second)
+		{
+			if (!first || !second)
+				return first ? std::move(first) : std::move(second);
+			return std::optional< R >(reduce(std::move(*first), std::move(*second)));
+		});
+	return result ? reduce(std::move(init), std::move(*result)) : init;
+}
+template< typename T >
+template< typename Make, typename Fold, typename Merge >
+std::invoke_result_t< Make& > BucketStorage< T >::foldBuckets(Make make, Fold fold, Merge merge) const
+{
+	using result_type = std::invoke_result_t< Make& >;
+
+	size_type threads = threadsFor(blocksCount);
+	if (threads < 2)
+	{
+		result_type result = make();
+		for (const Bucket* bucket = first; !bucket->isEnd(); bucket = bucket->getNext())
+			fold(result, *bucket);
+		return result;
+	}
+
+	std::vector< const Bucket* > buckets;
+	buckets.reserve(blocksCount);
+	for (const Bucket* bucket = first; !bucket->isEnd(); bucket = bucket->getNext())
+		buckets.push_back(bucket);
+
+	std::vector< std::optional< result_type > > partial(threads);
+	std::vector< std::exception_ptr > errors(threads);
+	std::vector< size_type > bounds = chunkBounds(buckets, threads);
+	runChunks(
+		threads,
+		[&](size_type chunk)
+		{
+			try
+			{
+				result_type result = make();
+				for (size_type i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+					fold(result, *buckets[i]);
+				partial[chunk].emplace(std::move(result));
+			} catch (...)
+			{
+				errors[chunk] = std::current_exception();
+			}
+		});
+
+	for (size_type chunk = 0; chunk < threads; ++chunk)
+		if (errors[chunk])
+			std::rethrow_exception(errors[chunk]);
+
+	result_type result = std::move(*partial[0]);
+	for (size_type chunk = 1; chunk < threads; ++chunk)
+		result = merge(std::move(result), std::move(*partial[chunk]));
+	return result;
+}
+template< typename T >
+template< typename P >
+std::vector< typename BucketStorage< T >::size_type > BucketStorage< T >::chunkBounds(const std::vector< P >& buckets, size_type threads) const
+{
+	std::vector< size_type > bounds(threads + 1);
+	for (size_type chunk = 0; chunk <= threads; ++chunk)
+		bounds[chunk] = buckets.size() * chunk / threads;
+
+	auto byOwner = [](const Bucket* lhs, const Bucket* rhs) { return lhs->getOwner() < rhs->getOwner(); };
+	if (!generalContent->getThreadAffinity() || buckets.empty() || buckets.front()->getOwner() == NO_OWNER ||
+		!std::is_sorted(buckets.begin(), buckets.end(), byOwner))
+		return bounds;
+
+	auto below = [](const Bucket* bucket, size_type owner) { return bucket->getOwner() < owner; };
+	for (size_type chunk = 1; chunk < threads; ++chunk)
+		bounds[chunk] = std::lower_bound(buckets.begin(), buckets.end(), chunk, below) - buckets.begin();
+	return bounds;
+}
+template< typename T >
+template< typename F >
+void BucketStorage< T >::runChunks(size_type threads, F work) const
+{
+	auto run = [&work, pinned = generalContent->getThreadAffinity()](size_type chunk)
+	{
+		if (!pinned)
+			return work(chunk);
+		ThreadAffinityScope scope(chunk);
+		work(chunk);
+	};
+
+	std::vector< std::thread > workers;
+	for (size_type chunk = 1; chunk < threads; ++chunk)
+	{
+		try
+		{
+			workers.emplace_back(run, chunk);
+		} catch (const std::exception&)
+		{
+			run(chunk);
+		}
+	}
+	run(0);
+	for (auto& worker : workers)
+		worker.join();
+}
+
+// ------------------------------------------
+// START OF BUCKET IMPLEMENTATION
+// ------------------------------------------
+
+template< typename T >
+template< typename U >
+constexpr U* BucketStorage< T >::Bucket::allocateMemory(size_type count) const
+{
+	if (std::is_constant_evaluated())
+		return std::allocator< U >().allocate(count);
+	size_type align = slabAlignment(count * sizeof(U), alignof(U));
+	if (!cached)
+		return static_cast< U* >(SlabCache::acquire_uncached(sizeof(U), align, count));
+	return static_cast< U* >(SlabCache::local().acquire(sizeof(U), align, count));
+}
+template< typename T >
+template< typename U >
+constexpr void BucketStorage< T >::Bucket::releaseMemory(U*& memory) const noexcept
+{
+	if (memory == nullptr)
+		return;
+	if (std::is_constant_evaluated())
+		std::allocator< U >().deallocate(std::exchange(memory, nullptr), capacity);
+	else if (!cached)
+		SlabCache::release_uncached(std::exchange(memory, nullptr), sizeof(U), slabAlignment(capacity * sizeof(U), alignof(U)), capacity);
+	else
+		SlabCache::local().release(std::exchange(memory, nullptr), sizeof(U), slabAlignment(capacity * sizeof(U), alignof(U)), capacity);
+}
+template< typename T >
+constexpr BucketStorage< T >::Bucket::Bucket() :
+	generalContent(nullptr), id(std::numeric_limits< id_type >::max()), next(nullptr), prev(nullptr),
+	nextIncomplete(nullptr), prevIncomplete(nullptr), capacity(0), data(nullptr), nextData(nullptr), prevData(nullptr),
+	idData(nullptr), owner(NO_OWNER), size(0), firstIndex(0), lastIndex(0)
+{
+}
+template< typename T >
+constexpr BucketStorage< T >::Bucket::Bucket(GeneralBucketContent* generalContent, Bucket* next, Bucket* prev, Bucket* incomplete) :
+	generalContent(generalContent), id(generalContent->id()), next(next), prev(prev), nextIncomplete(incomplete),
+	prevIncomplete(nullptr), capacity(generalContent->getBlockCapacity()), data(nullptr), nextData(nullptr),
+	prevData(nullptr), idData(nullptr), owner(NO_OWNER), size(0), firstIndex(0), lastIndex(0)
+{
+	allocate();
+#ifdef BUCKET_STORAGE_GENERATIONS
+	try
+	{
+		enroll();
+	} catch (...)
+	{
+		deallocate();
+		throw;
+	}
+#endif
+
+	if (next != nullptr)
+		next->prev = this;
+	if (prev != nullptr)
+		prev->next = this;
+	if (incomplete != nullptr)
+		incomplete->prevIncomplete = this;
+}
+template< typename T >
+constexpr BucketStorage< T >::Bucket::Bucket(const Bucket& other, GeneralBucketContent* generalContent, Bucket* next, Bucket* prev) :
+	generalContent(generalContent), id(other.id), next(next), prev(prev), nextIncomplete(nullptr), prevIncomplete(nullptr),
+	capacity(other.capacity), data(nullptr), nextData(nullptr), prevData(nullptr), idData(nullptr), owner(NO_OWNER),
+	size(other.size), firstIndex(other.firstIndex), lastIndex(other.lastIndex)
+{
+	allocate();
+
+	if (!other.isEmpty())
+	{
+		size_type index = firstIndex;
+		do
+		{
+			nextData[index] = other.nextData[index];
+			prevData[index] = other.prevData[index];
+			index = other.nextData[index];
+		} while (index != firstIndex);
+	}
+
+	auto it = const_iterator(const_cast< Bucket* >(&other), other.getFirstIndex());
+	try
+	{
+		for (; it.bucket == &other; ++it)
+		{
+			std::construct_at(&data[it.index], *it);
+			idData[it.index] = other.idData[it.index];
+		}
+	} catch (...)
+	{
+		for (auto done = const_iterator(const_cast< Bucket* >(&other), other.getFirstIndex()); done != it; ++done)
+			std::destroy_at(&data[done.index]);
+		deallocate();
+		throw;
+	}
+
+	if (next != nullptr)
+		next->prev = this;
+	if (prev != nullptr)
+		prev->next = this;
+}
+template< typename T >
+BucketStorage< T >::Bucket::Bucket(GeneralBucketContent* generalContent, id_type id) :
+	generalContent(generalContent), id(id), next(nullptr), prev(nullptr), nextIncomplete(nullptr), prevIncomplete(nullptr),
+	capacity(generalContent->getBlockCapacity()), data(nullptr), nextData(nullptr), prevData(nullptr), idData(nullptr),
+	owner(NO_OWNER), size(0), firstIndex(0), lastIndex(0)
 {
-	return std::numeric_limits< size_type >::max() / sizeof(T);
+	cached = !generalContent->getThreadAffinity();
+	allocate();
+	touch();
+	parkedAt = std::chrono::steady_clock::now();
 }
 template< typename T >
-BucketStorage< T >::iterator BucketStorage< T >::begin() noexcept
+constexpr BucketStorage< T >::Bucket::~Bucket()
 {
-	return iterator(first, first->getFirstIndex());
+	size_type index = firstIndex;
+	for (size_type i = 0; i < size; ++i)
+	{
+		std::destroy_at(&data[index]);
+		index = nextData[index];
+		BUCKET_STORAGE_COUNT(slotTraversals, 1);
+	}
+
+	if (generalContent != nullptr)
+		deallocate();
 }
 template< typename T >
-BucketStorage< T >::const_iterator BucketStorage< T >::begin() const noexcept
+constexpr void BucketStorage< T >::Bucket::allocate()
 {
-	return const_iterator(first, first->getFirstIndex());
+	BUCKET_STORAGE_COUNT(allocations, 1);
+	generalContent->charge(footprint(capacity));
+	try
+	{
+		data = allocateMemory< T >(capacity);
+		nextData = allocateMemory< size_type >(capacity);
+		prevData = allocateMemory< size_type >(capacity);
+		idData = allocateMemory< id_type >(capacity);
+#ifdef BUCKET_STORAGE_GENERATIONS
+		generationData = allocateMemory< generation_type >(capacity);
+		for (size_type i = 0; i < capacity; ++i)
+			std::construct_at(&generationData[i], 0);
+#endif
+	} catch (...)
+	{
+		deallocate();
+		throw;
+	}
 }
 template< typename T >
-BucketStorage< T >::const_iterator BucketStorage< T >::cbegin() const noexcept
+constexpr void BucketStorage< T >::Bucket::deallocate() noexcept
 {
-	return const_iterator(first, first->getFirstIndex());
+	BUCKET_STORAGE_COUNT(deallocations, 1);
+	releaseMemory(data);
+	releaseMemory(nextData);
+	releaseMemory(prevData);
+	releaseMemory(idData);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	releaseMemory(generationData);
+#endif
+
+	generalContent->release(footprint(capacity));
 }
 template< typename T >
-BucketStorage< T >::iterator BucketStorage< T >::end() noexcept
+void BucketStorage< T >::Bucket::touch() noexcept
 {
-	return iterator(last, 0);
+	std::memset(static_cast< void* >(data), 0, capacity * sizeof(T));
+	std::fill_n(nextData, capacity, 0);
+	std::fill_n(prevData, capacity, 0);
+	std::fill_n(idData, capacity, 0);
 }
 template< typename T >
-BucketStorage< T >::const_iterator BucketStorage< T >::end() const noexcept
+constexpr bool BucketStorage< T >::Bucket::isPaged(size_type bytes) noexcept
 {
-	return const_iterator(last, 0);
+	return bytes >= PAGED_SLAB_BYTES;
 }
 template< typename T >
-BucketStorage< T >::const_iterator BucketStorage< T >::cend() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::slabAlignment(size_type bytes, size_type natural) noexcept
 {
-	return const_iterator(last, 0);
+	return isPaged(bytes) ? std::max(natural, SLAB_PAGE_SIZE) : natural;
 }
 template< typename T >
-void BucketStorage< T >::resetPointers()
+BucketStorage< T >::size_type BucketStorage< T >::Bucket::advisePages(void* memory, size_type bytes) noexcept
 {
-	first = nullptr;
-	last = nullptr;
-	incomplete = nullptr;
-	dataSize = 0;
+#if defined(__linux__)
+	if (memory == nullptr || !isPaged(bytes))
+		return 0;
+
+	uintptr_t begin = (reinterpret_cast< uintptr_t >(memory) + SLAB_PAGE_SIZE - 1) & ~uintptr_t(SLAB_PAGE_SIZE - 1);
+	uintptr_t end = (reinterpret_cast< uintptr_t >(memory) + bytes) & ~uintptr_t(SLAB_PAGE_SIZE - 1);
+	if (end <= begin || madvise(reinterpret_cast< void* >(begin), end - begin, MADV_DONTNEED) != 0)
+		return 0;
+	return end - begin;
+#else
+	static_cast< void >(memory);
+	static_cast< void >(bytes);
+	return 0;
+#endif
 }
 template< typename T >
-void BucketStorage< T >::cleanup()
+constexpr void BucketStorage< T >::Bucket::setNext(BucketStorage< T >::Bucket* value) noexcept
 {
-	clear();
-	delete last;
+	BUCKET_STORAGE_COUNT(metadataWrites, 1);
+	next = value;
 }
-
-// ------------------------------------------
-// START OF BUCKET IMPLEMENTATION
-// ------------------------------------------
-
 template< typename T >
-template< typename U >
-U* BucketStorage< T >::Bucket::allocateMemory(size_type count) const
+constexpr void BucketStorage< T >::Bucket::setPrev(BucketStorage< T >::Bucket* value) noexcept
 {
-	return static_cast< U* >(::operator new(sizeof(U) * count));
+	BUCKET_STORAGE_COUNT(metadataWrites, 1);
+	prev = value;
 }
 template< typename T >
-BucketStorage< T >::Bucket::Bucket() :
-	generalContent(nullptr), id(std::numeric_limits< id_type >::max()), next(nullptr), prev(nullptr),
-	nextIncomplete(nullptr), prevIncomplete(nullptr), data(nullptr), size(0), firstIndex(0), lastIndex(0),
-	nextData(nullptr), prevData(nullptr), idData(nullptr)
+constexpr void BucketStorage< T >::Bucket::setNextIncomplete(BucketStorage< T >::Bucket* value) noexcept
 {
+	BUCKET_STORAGE_COUNT(metadataWrites, 1);
+	nextIncomplete = value;
 }
 template< typename T >
-BucketStorage< T >::Bucket::Bucket(GeneralBucketContent* generalContent, Bucket* next, Bucket* prev, Bucket* incomplete) :
-	generalContent(generalContent), id(generalContent->id()), next(next), prev(prev), nextIncomplete(incomplete),
-	prevIncomplete(nullptr), data(allocateMemory< T >(generalContent->getBlockCapacity())), size(0), firstIndex(0),
-	lastIndex(0), nextData(allocateMemory< size_type >(generalContent->getBlockCapacity())),
-	prevData(allocateMemory< size_type >(generalContent->getBlockCapacity())),
-	idData(allocateMemory< id_type >(generalContent->getBlockCapacity()))
+constexpr void BucketStorage< T >::Bucket::setPrevIncomplete(BucketStorage< T >::Bucket* value) noexcept
 {
-	if (next != nullptr)
-		next->prev = this;
-	if (prev != nullptr)
-		prev->next = this;
-	if (incomplete != nullptr)
-		incomplete->prevIncomplete = this;
+	BUCKET_STORAGE_COUNT(metadataWrites, 1);
+	prevIncomplete = value;
 }
 template< typename T >
-BucketStorage< T >::Bucket::Bucket(const Bucket& other, GeneralBucketContent* generalContent, Bucket* next, Bucket* prev) :
-	generalContent(generalContent), id(other.id), next(next), prev(prev), nextIncomplete(nullptr), prevIncomplete(nullptr),
-	data(allocateMemory< T >(generalContent->getBlockCapacity())), size(other.size), firstIndex(other.firstIndex),
-	lastIndex(other.lastIndex), nextData(allocateMemory< size_type >(generalContent->getBlockCapacity())),
-	prevData(allocateMemory< size_type >(generalContent->getBlockCapacity())),
-	idData(allocateMemory< id_type >(generalContent->getBlockCapacity()))
+constexpr void BucketStorage< T >::Bucket::setOwner(size_type value) noexcept
 {
-	if (next != nullptr)
-		next->prev = this;
-	if (prev != nullptr)
-		prev->next = this;
-
-	for (auto it = const_iterator(const_cast< Bucket* >(&other), other.getFirstIndex()); it.bucket == &other; ++it)
-	{
-		new (&data[it.index]) T(*it);
-		nextData[it.index] = other.nextData[it.index];
-		prevData[it.index] = other.prevData[it.index];
-		idData[it.index] = other.idData[it.index];
-	}
+	owner = value;
 }
 template< typename T >
-BucketStorage< T >::Bucket::~Bucket()
+constexpr void BucketStorage< T >::Bucket::link(Bucket* next, Bucket* prev, Bucket* incomplete)
 {
-	if (!isEmpty())
+#ifdef BUCKET_STORAGE_GENERATIONS
+	enroll();
+	if (advised)
+		std::fill_n(generationData, capacity, 0);
+#endif
+	advised = false;
+	id = generalContent->id();
+	size_type index = firstIndex;
+	for (size_type i = 0; i < size; ++i)
 	{
-		auto it = const_iterator(this, getFirstIndex());
-		while (it.bucket == this)
-		{
-			data[it.index].~T();
-			++it;
-		}
+		idData[index] = generalContent->id();
+		index = nextData[index];
 	}
-
-	::operator delete(data);
-	::operator delete(nextData);
-	::operator delete(prevData);
-	::operator delete(idData);
-
-	data = nullptr;
-	nextData = nullptr;
-	prevData = nullptr;
-	idData = nullptr;
-}
-template< typename T >
-void BucketStorage< T >::Bucket::setNext(BucketStorage< T >::Bucket* value) noexcept
-{
-	next = value;
+	this->next = next;
+	this->prev = prev;
+	nextIncomplete = incomplete;
+	if (next != nullptr)
+		next->prev = this;
+	if (prev != nullptr)
+		prev->next = this;
+	if (incomplete != nullptr)
+		incomplete->prevIncomplete = this;
 }
 template< typename T >
-void BucketStorage< T >::Bucket::setPrev(BucketStorage< T >::Bucket* value) noexcept
+void BucketStorage< T >::Bucket::park() noexcept
 {
-	prev = value;
+	parkedAt = std::chrono::steady_clock::now();
 }
 template< typename T >
-void BucketStorage< T >::Bucket::setNextIncomplete(BucketStorage< T >::Bucket* value) noexcept
+BucketStorage< T >::size_type BucketStorage< T >::Bucket::advise(std::chrono::steady_clock::time_point cutoff) noexcept
 {
-	nextIncomplete = value;
+	if (advised || parkedAt > cutoff)
+		return 0;
+
+	size_type bytes = advisePages(data, capacity * sizeof(T)) + advisePages(nextData, capacity * sizeof(size_type)) +
+					  advisePages(prevData, capacity * sizeof(size_type)) + advisePages(idData, capacity * sizeof(id_type));
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bytes += advisePages(generationData, capacity * sizeof(generation_type));
+#endif
+	advised = true;
+	return bytes;
 }
 template< typename T >
-void BucketStorage< T >::Bucket::setPrevIncomplete(BucketStorage< T >::Bucket* value) noexcept
+void BucketStorage< T >::Bucket::rebind(GeneralBucketContent* value) noexcept
 {
-	prevIncomplete = value;
+	if (value->getBudget() != generalContent->getBudget())
+	{
+		value->forceCharge(footprint(capacity));
+		generalContent->release(footprint(capacity));
+	}
+	generalContent = value;
+	id = value->id();
 }
 template< typename T >
-BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getNext() const noexcept
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getNext() const noexcept
 {
+	BUCKET_STORAGE_COUNT(bucketTraversals, 1);
 	return next;
 }
 template< typename T >
-BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getPrev() const noexcept
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getPrev() const noexcept
 {
+	BUCKET_STORAGE_COUNT(bucketTraversals, 1);
 	return prev;
 }
 template< typename T >
-BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getNextIncomplete() const noexcept
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getNextIncomplete() const noexcept
 {
+	BUCKET_STORAGE_COUNT(bucketTraversals, 1);
 	return nextIncomplete;
 }
 template< typename T >
-BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getPrevIncomplete() const noexcept
+constexpr BucketStorage< T >::Bucket* BucketStorage< T >::Bucket::getPrevIncomplete() const noexcept
 {
+	BUCKET_STORAGE_COUNT(bucketTraversals, 1);
 	return prevIncomplete;
 }
 template< typename T >
-BucketStorage< T >::id_type BucketStorage< T >::Bucket::getId() const noexcept
+constexpr BucketStorage< T >::id_type BucketStorage< T >::Bucket::getId() const noexcept
 {
 	return id;
 }
 template< typename T >
-BucketStorage< T >::id_type BucketStorage< T >::Bucket::getDataId(unsigned long long int index)
+constexpr BucketStorage< T >::id_type BucketStorage< T >::Bucket::getDataId(size_type index)
 {
 	return idData[index];
 }
 template< typename T >
-unsigned long long int BucketStorage< T >::Bucket::getSize() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getSize() const noexcept
 {
 	return size;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::Bucket::getFirstIndex() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getCapacity() const noexcept
+{
+	return capacity;
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getOwner() const noexcept
+{
+	return owner;
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getFirstIndex() const noexcept
 {
 	return firstIndex;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::Bucket::getLastIndex() const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getLastIndex() const noexcept
 {
 	return lastIndex;
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::Bucket::getNextIndex(size_type index) const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getNextIndex(size_type index) const noexcept
 {
+	BUCKET_STORAGE_COUNT(slotTraversals, 1);
 	return nextData[index];
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::Bucket::getPrevIndex(size_type index) const noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getPrevIndex(size_type index) const noexcept
 {
+	BUCKET_STORAGE_COUNT(slotTraversals, 1);
 	return prevData[index];
 }
 template< typename T >
-bool BucketStorage< T >::Bucket::isBegin() const noexcept
+void BucketStorage< T >::Bucket::prefetchSlot(size_type index) const noexcept
+{
+	prefetchForWrite(nextData + index);
+	prefetchForWrite(prevData + index);
+}
+#ifdef BUCKET_STORAGE_GENERATIONS
+template< typename T >
+constexpr void BucketStorage< T >::Bucket::enroll()
+{
+	uint64_t value = std::is_constant_evaluated() ? 1 : nextStamp();
+	record = generalContent->enroll(value);
+	stamp = value;
+}
+template< typename T >
+constexpr void BucketStorage< T >::Bucket::retire() noexcept
+{
+	if (stamp != 0)
+		generalContent->retire(record);
+	stamp = 0;
+}
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::getRecord() const noexcept
+{
+	return record;
+}
+template< typename T >
+constexpr uint64_t BucketStorage< T >::Bucket::getStamp() const noexcept
+{
+	return stamp;
+}
+template< typename T >
+constexpr BucketStorage< T >::generation_type BucketStorage< T >::Bucket::getGeneration(size_type index) const noexcept
+{
+	return generationData[index];
+}
+template< typename T >
+uint64_t BucketStorage< T >::Bucket::nextStamp() noexcept
+{
+	static std::atomic< uint64_t > counter(0);
+	return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+#endif
+template< typename T >
+constexpr bool BucketStorage< T >::Bucket::isBegin() const noexcept
 {
 	return prev == nullptr;
 }
 template< typename T >
-bool BucketStorage< T >::Bucket::isEnd() const noexcept
+constexpr bool BucketStorage< T >::Bucket::isEnd() const noexcept
 {
 	return next == nullptr;
 }
 template< typename T >
-BucketStorage< T >::Bucket::reference BucketStorage< T >::Bucket::getReference(size_type index)
+constexpr BucketStorage< T >::Bucket::reference BucketStorage< T >::Bucket::getReference(size_type index)
 {
 	return data[index];
 }
 template< typename T >
-BucketStorage< T >::Bucket::pointer BucketStorage< T >::Bucket::getPointer(size_type index)
+constexpr BucketStorage< T >::Bucket::pointer BucketStorage< T >::Bucket::getPointer(size_type index)
 {
 	return &data[index];
 }
 template< typename T >
-BucketStorage< T >::Bucket::const_reference BucketStorage< T >::Bucket::getReference(size_type index) const
+constexpr BucketStorage< T >::Bucket::const_reference BucketStorage< T >::Bucket::getReference(size_type index) const
 {
 	return data[index];
 }
 template< typename T >
-BucketStorage< T >::Bucket::const_pointer BucketStorage< T >::Bucket::getPointer(size_type index) const
+constexpr BucketStorage< T >::Bucket::const_pointer BucketStorage< T >::Bucket::getPointer(size_type index) const
 {
 	return &data[index];
 }
 template< typename T >
-BucketStorage< T >::size_type BucketStorage< T >::Bucket::prepareInsert() noexcept
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::prepareInsert() noexcept
 {
 	if (isEmpty())
 	{
@@ -748,9 +2694,9 @@ BucketStorage< T >::size_type BucketStorage< T >::Bucket::prepareInsert() noexce
 	return nextData[lastIndex];
 }
 template< typename T >
-void BucketStorage< T >::Bucket::completeInsert(size_type index) noexcept
+constexpr void BucketStorage< T >::Bucket::completeInsert(size_type index) noexcept
 {
-	if (size == index)
+	if (isEmpty() || nextData[lastIndex] == firstIndex)
 	{
 		reconnectData(lastIndex, firstIndex, index, index);
 		reconnectData(index, index, firstIndex, lastIndex);
@@ -760,24 +2706,31 @@ void BucketStorage< T >::Bucket::completeInsert(size_type index) noexcept
 	++size;
 }
 template< typename T >
-void BucketStorage< T >::Bucket::reconnectData(size_type nextIndex, size_type prevIndex, size_type nextValue, size_type prevValue) noexcept
+constexpr void BucketStorage< T >::Bucket::reconnectData(size_type nextIndex, size_type prevIndex, size_type nextValue, size_type prevValue) noexcept
 {
+	BUCKET_STORAGE_COUNT(metadataWrites, 2);
 	nextData[nextIndex] = nextValue;
 	prevData[prevIndex] = prevValue;
 }
 template< typename T >
 template< typename U >
-BucketStorage< T >::iterator BucketStorage< T >::Bucket::insert(U&& value)
+constexpr BucketStorage< T >::iterator BucketStorage< T >::Bucket::insert(U&& value)
 {
 	size_type index = prepareInsert();
-	new (&data[index]) T(std::forward< U >(value));
+	{
+		BUCKET_STORAGE_MEASURE(Construction);
+		std::construct_at(&data[index], std::forward< U >(value));
+	}
 	completeInsert(index);
 	return iterator(this, index);
 }
 template< typename T >
-void BucketStorage< T >::Bucket::erase(size_type index)
+constexpr void BucketStorage< T >::Bucket::erase(size_type index)
 {
-	data[index].~T();
+	std::destroy_at(&data[index]);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	++generationData[index];
+#endif
 
 	if (index == firstIndex)
 		firstIndex = nextData[firstIndex];
@@ -796,15 +2749,200 @@ void BucketStorage< T >::Bucket::erase(size_type index)
 	--size;
 }
 template< typename T >
-bool BucketStorage< T >::Bucket::isFull() const noexcept
+template< typename F >
+constexpr void BucketStorage< T >::Bucket::forEach(F f) const
+{
+	BUCKET_STORAGE_MEASURE(BucketScan);
+	size_type index = firstIndex;
+	for (size_type i = 0; i < size; ++i)
+	{
+		f(data[index]);
+		index = nextData[index];
+		BUCKET_STORAGE_COUNT(slotTraversals, 1);
+	}
+}
+template< typename T >
+template< typename F >
+constexpr void BucketStorage< T >::Bucket::drain(F& consumer)
+{
+	BUCKET_STORAGE_MEASURE(BucketScan);
+	while (size != 0)
+	{
+		consumer(std::move(data[firstIndex]));
+		std::destroy_at(&data[firstIndex]);
+#ifdef BUCKET_STORAGE_GENERATIONS
+		++generationData[firstIndex];
+#endif
+		firstIndex = nextData[firstIndex];
+		BUCKET_STORAGE_COUNT(slotTraversals, 1);
+		--size;
+	}
+}
+template< typename T >
+constexpr bool BucketStorage< T >::Bucket::isFull() const noexcept
 {
-	return size == generalContent->getBlockCapacity();
+	return size == capacity;
 }
 template< typename T >
-bool BucketStorage< T >::Bucket::isEmpty() const noexcept
+constexpr bool BucketStorage< T >::Bucket::isEmpty() const noexcept
 {
 	return size == 0;
 }
+template< typename T >
+constexpr BucketStorage< T >::size_type BucketStorage< T >::Bucket::footprint(size_type capacity) noexcept
+{
+	size_type slot = sizeof(T) + 2 * sizeof(size_type) + sizeof(id_type);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	slot += sizeof(generation_type);
+#endif
+	return sizeof(Bucket) + capacity * slot;
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::Bucket::memoryUsage() const noexcept
+{
+	size_type result = allocationSize(this, sizeof(Bucket)) + allocationSize(data, capacity * sizeof(T)) +
+					   allocationSize(nextData, capacity * sizeof(size_type)) +
+					   allocationSize(prevData, capacity * sizeof(size_type)) + allocationSize(idData, capacity * sizeof(id_type));
+#ifdef BUCKET_STORAGE_GENERATIONS
+	result += allocationSize(generationData, capacity * sizeof(generation_type));
+#endif
+	return result;
+}
+
+// ------------------------------------------
+// START OF BUCKET VIEW IMPLEMENTATION
+// ------------------------------------------
+
+template< typename T >
+BucketStorage< T >::BucketView::BucketView(const Bucket* bucket) noexcept : bucket(bucket)
+{
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::BucketView::size() const noexcept
+{
+	return bucket->getSize();
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::BucketView::capacity() const noexcept
+{
+	return bucket->getCapacity();
+}
+template< typename T >
+BucketStorage< T >::id_type BucketStorage< T >::BucketView::id() const noexcept
+{
+	return bucket->getId();
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::BucketView::owner() const noexcept
+{
+	return bucket->getOwner();
+}
+template< typename T >
+template< typename F >
+void BucketStorage< T >::BucketView::for_each(F f) const
+{
+	bucket->forEach(f);
+}
+template< typename T >
+BucketStorage< T >::const_iterator BucketStorage< T >::BucketView::begin() const noexcept
+{
+	return const_iterator(const_cast< Bucket* >(bucket), bucket->getFirstIndex());
+}
+template< typename T >
+BucketStorage< T >::const_iterator BucketStorage< T >::BucketView::end() const noexcept
+{
+	Bucket* next = bucket->getNext();
+	return const_iterator(next, next->getFirstIndex());
+}
+
+// ------------------------------------------
+// START OF FROZEN STORAGE IMPLEMENTATION
+// ------------------------------------------
+
+template< typename T >
+BucketStorage< T >::FrozenStorage::FrozenStorage(size_type block_capacity) noexcept : blockCapacity(block_capacity)
+{
+}
+template< typename T >
+bool BucketStorage< T >::FrozenStorage::empty() const noexcept
+{
+	return elements.empty();
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::FrozenStorage::size() const noexcept
+{
+	return elements.size();
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::FrozenStorage::bucket_count() const noexcept
+{
+	return bounds.size();
+}
+template< typename T >
+BucketStorage< T >::size_type BucketStorage< T >::FrozenStorage::memory_usage() const noexcept
+{
+	return sizeof(FrozenStorage) + elements.capacity() * sizeof(T) + bounds.capacity() * sizeof(size_type);
+}
+template< typename T >
+BucketStorage< T >::FrozenStorage::const_reference BucketStorage< T >::FrozenStorage::operator[](size_type index) const noexcept
+{
+	return elements[index];
+}
+template< typename T >
+BucketStorage< T >::FrozenStorage::const_reference BucketStorage< T >::FrozenStorage::at(size_type index) const
+{
+	if (index >= elements.size())
+		throw std::out_of_range("index is out of frozen storage range");
+	return elements[index];
+}
+template< typename T >
+std::span< const T > BucketStorage< T >::FrozenStorage::bucket(size_type index) const
+{
+	if (index >= bounds.size())
+		throw std::out_of_range("bucket index is out of frozen storage range");
+
+	size_type from = index == 0 ? 0 : bounds[index - 1];
+	return std::span< const T >(elements.data() + from, bounds[index] - from);
+}
+template< typename T >
+BucketStorage< T > BucketStorage< T >::FrozenStorage::thaw()
+{
+	BucketStorage< T > result(blockCapacity);
+	for (T& value : elements)
+		result.insert(std::move(value));
+
+	*this = FrozenStorage(blockCapacity);
+	return result;
+}
+template< typename T >
+template< typename Make, typename Fold, typename Merge >
+std::invoke_result_t< Make& > BucketStorage< T >::FrozenStorage::fold_buckets(Make make, Fold fold, Merge) const
+{
+	std::invoke_result_t< Make& > result = make();
+	for (size_type index = 0; index < bounds.size(); ++index)
+		fold(result, bucket(index));
+	return result;
+}
+template< typename T >
+BucketStorage< T >::FrozenStorage::const_iterator BucketStorage< T >::FrozenStorage::begin() const noexcept
+{
+	return elements.data();
+}
+template< typename T >
+BucketStorage< T >::FrozenStorage::const_iterator BucketStorage< T >::FrozenStorage::cbegin() const noexcept
+{
+	return begin();
+}
+template< typename T >
+BucketStorage< T >::FrozenStorage::const_iterator BucketStorage< T >::FrozenStorage::end() const noexcept
+{
+	return elements.data() + elements.size();
+}
+template< typename T >
+BucketStorage< T >::FrozenStorage::const_iterator BucketStorage< T >::FrozenStorage::cend() const noexcept
+{
+	return end();
+}
 
 // ------------------------------------------
 // START OF ITERATOR IMPLEMENTATION
@@ -812,13 +2950,18 @@ bool BucketStorage< T >::Bucket::isEmpty() const noexcept
 
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >::AbstractIterator(const AbstractIterator& other) :
+constexpr BucketStorage< T >::AbstractIterator< IsConst >::AbstractIterator(const AbstractIterator& other) :
 	bucket(other.bucket), index(other.index)
 {
+#ifdef BUCKET_STORAGE_GENERATIONS
+	record = other.record;
+	stamp = other.stamp;
+	generation = other.generation;
+#endif
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::shiftNextBucket()
+constexpr BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::shiftNextBucket()
 {
 	if (bucket->isEnd())
 		return *this;
@@ -826,11 +2969,14 @@ BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIter
 	auto temp = *this;
 	bucket = bucket->getNext();
 	index = bucket->getFirstIndex();
+#ifdef BUCKET_STORAGE_GENERATIONS
+	capture();
+#endif
 	return temp;
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::shiftPrevBucket()
+constexpr BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::shiftPrevBucket()
 {
 	auto temp = *this;
 	if (bucket->isBegin())
@@ -840,23 +2986,31 @@ BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIter
 		bucket = bucket->getPrev();
 		index = bucket->getLastIndex();
 	}
+#ifdef BUCKET_STORAGE_GENERATIONS
+	capture();
+#endif
 	return temp;
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >&
+constexpr BucketStorage< T >::AbstractIterator< IsConst >&
 	BucketStorage< T >::AbstractIterator< IsConst >::operator=(const AbstractIterator& other)
 {
 	if (this != &other)
 	{
 		bucket = other.bucket;
 		index = other.index;
+#ifdef BUCKET_STORAGE_GENERATIONS
+		record = other.record;
+		stamp = other.stamp;
+		generation = other.generation;
+#endif
 	}
 	return *this;
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::operator++(int)
+constexpr BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::operator++(int)
 {
 	auto temp = *this;
 	++(*this);
@@ -864,17 +3018,22 @@ BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIter
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >& BucketStorage< T >::AbstractIterator< IsConst >::operator++()
+constexpr BucketStorage< T >::AbstractIterator< IsConst >& BucketStorage< T >::AbstractIterator< IsConst >::operator++()
 {
 	if (index != bucket->getLastIndex())
+	{
 		index = bucket->getNextIndex(index);
+#ifdef BUCKET_STORAGE_GENERATIONS
+		capture();
+#endif
+	}
 	else
 		shiftNextBucket();
 	return *this;
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::operator--(int)
+constexpr BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIterator< IsConst >::operator--(int)
 {
 	auto temp = *this;
 	--(*this);
@@ -882,48 +3041,53 @@ BucketStorage< T >::AbstractIterator< IsConst > BucketStorage< T >::AbstractIter
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >& BucketStorage< T >::AbstractIterator< IsConst >::operator--()
+constexpr BucketStorage< T >::AbstractIterator< IsConst >& BucketStorage< T >::AbstractIterator< IsConst >::operator--()
 {
 	if (index != bucket->getFirstIndex())
+	{
 		index = bucket->getPrevIndex(index);
+#ifdef BUCKET_STORAGE_GENERATIONS
+		capture();
+#endif
+	}
 	else
 		shiftPrevBucket();
 	return *this;
 }
 template< typename T >
 template< bool IsConst >
-bool BucketStorage< T >::AbstractIterator< IsConst >::operator==(const AbstractIterator< true >& other) const noexcept
+constexpr bool BucketStorage< T >::AbstractIterator< IsConst >::operator==(const AbstractIterator< true >& other) const noexcept
 {
 	return bucket == other.bucket && index == other.index;
 }
 
 template< typename T >
 template< bool IsConst >
-bool BucketStorage< T >::AbstractIterator< IsConst >::operator!=(const AbstractIterator< true >& other) const noexcept
+constexpr bool BucketStorage< T >::AbstractIterator< IsConst >::operator!=(const AbstractIterator< true >& other) const noexcept
 {
 	return !(*this == other);
 }
 template< typename T >
 template< bool IsConst >
-bool BucketStorage< T >::AbstractIterator< IsConst >::operator<=(const AbstractIterator< true >& other) const noexcept
+constexpr bool BucketStorage< T >::AbstractIterator< IsConst >::operator<=(const AbstractIterator< true >& other) const noexcept
 {
 	return *this < other || *this == other;
 }
 template< typename T >
 template< bool IsConst >
-bool BucketStorage< T >::AbstractIterator< IsConst >::operator<(const AbstractIterator< true >& other) const noexcept
+constexpr bool BucketStorage< T >::AbstractIterator< IsConst >::operator<(const AbstractIterator< true >& other) const noexcept
 {
 	return !(*this >= other);
 }
 template< typename T >
 template< bool IsConst >
-bool BucketStorage< T >::AbstractIterator< IsConst >::operator>=(const AbstractIterator< true >& other) const noexcept
+constexpr bool BucketStorage< T >::AbstractIterator< IsConst >::operator>=(const AbstractIterator< true >& other) const noexcept
 {
 	return *this > other || *this == other;
 }
 template< typename T >
 template< bool IsConst >
-bool BucketStorage< T >::AbstractIterator< IsConst >::operator>(const AbstractIterator< true >& other) const noexcept
+constexpr bool BucketStorage< T >::AbstractIterator< IsConst >::operator>(const AbstractIterator< true >& other) const noexcept
 {
 	if (bucket->getId() == other.bucket->getId())
 		return !bucket->isEnd() && bucket->getDataId(index) > other.bucket->getDataId(other.index);
@@ -931,27 +3095,140 @@ bool BucketStorage< T >::AbstractIterator< IsConst >::operator>(const AbstractIt
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >::operator AbstractIterator< !IsConst >() const noexcept
-{
+constexpr BucketStorage< T >::AbstractIterator< IsConst >::operator AbstractIterator< !IsConst >() const noexcept
+{
+#ifdef BUCKET_STORAGE_GENERATIONS
+	AbstractIterator< !IsConst > result;
+	result.bucket = bucket;
+	result.index = index;
+	result.record = record;
+	result.stamp = stamp;
+	result.generation = generation;
+	return result;
+#else
 	return AbstractIterator< !IsConst >(bucket, index);
+#endif
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >::reference BucketStorage< T >::AbstractIterator< IsConst >::operator*() const
+constexpr BucketStorage< T >::AbstractIterator< IsConst >::reference BucketStorage< T >::AbstractIterator< IsConst >::operator*() const
 {
 	return bucket->getReference(index);
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >::pointer BucketStorage< T >::AbstractIterator< IsConst >::operator->() const
+constexpr BucketStorage< T >::AbstractIterator< IsConst >::pointer BucketStorage< T >::AbstractIterator< IsConst >::operator->() const
 {
 	return bucket->getPointer(index);
 }
 template< typename T >
 template< bool IsConst >
-BucketStorage< T >::AbstractIterator< IsConst >::AbstractIterator(Bucket* bucket, size_type index) :
+constexpr BucketStorage< T >::AbstractIterator< IsConst >::AbstractIterator(Bucket* bucket, size_type index) :
 	bucket(bucket), index(index)
 {
+#ifdef BUCKET_STORAGE_GENERATIONS
+	capture();
+#endif
+}
+#ifdef BUCKET_STORAGE_GENERATIONS
+template< typename T >
+template< bool IsConst >
+constexpr void BucketStorage< T >::AbstractIterator< IsConst >::capture() noexcept
+{
+	record = bucket->getRecord();
+	stamp = bucket->getStamp();
+	generation = bucket->isEnd() ? 0 : bucket->getGeneration(index);
+}
+#endif
+
+// ------------------------------------------
+// START OF TRANSACTION IMPLEMENTATION
+// ------------------------------------------
+
+template< typename T >
+BucketStorage< T >::Transaction::Transaction(BucketStorage< T >& storage) :
+	storage(&storage), firstId(storage.generalContent->getIdCounter()), pending(true)
+{
+}
+template< typename T >
+BucketStorage< T >::Transaction::Transaction(Transaction&& other) noexcept :
+	storage(other.storage), firstId(other.firstId), inserted(std::move(other.inserted)), erased(std::move(other.erased)),
+	pending(other.pending)
+{
+	other.pending = false;
+}
+template< typename T >
+BucketStorage< T >::Transaction::~Transaction() noexcept
+{
+	if (pending)
+	{
+		try
+		{
+			rollback();
+		} catch (...)
+		{
+		}
+	}
+}
+template< typename T >
+template< typename U >
+BucketStorage< T >::iterator BucketStorage< T >::Transaction::insert(U&& value)
+{
+	auto it = storage->insert(std::forward< U >(value));
+	try
+	{
+		inserted.emplace(it.bucket->getDataId(it.index), it);
+	} catch (...)
+	{
+		storage->erase(it);
+		throw;
+	}
+	return it;
+}
+template< typename T >
+BucketStorage< T >::iterator BucketStorage< T >::Transaction::erase(const_iterator it)
+{
+	if (it.bucket->getDataId(it.index) >= firstId)
+		inserted.erase(it.bucket->getDataId(it.index));
+	else
+		erased.push_back(std::move(it.bucket->getReference(it.index)));
+	return storage->erase(it);
+}
+template< typename T >
+void BucketStorage< T >::Transaction::commit() noexcept
+{
+	inserted.clear();
+	erased.clear();
+	pending = false;
+}
+template< typename T >
+void BucketStorage< T >::Transaction::rollback()
+{
+	for (const auto& [id, it] : inserted)
+		storage->erase(it);
+	inserted.clear();
+
+	GeneralBucketContent* content = storage->generalContent;
+	content->setOvercommit(true);
+	try
+	{
+		while (!erased.empty())
+		{
+			storage->insert(std::move(erased.back()));
+			erased.pop_back();
+		}
+	} catch (...)
+	{
+		content->setOvercommit(false);
+		throw;
+	}
+	content->setOvercommit(false);
+	pending = false;
+}
+template< typename T >
+bool BucketStorage< T >::Transaction::active() const noexcept
+{
+	return pending;
 }
 
 #endif /* BUCKET_STORAGE_H */
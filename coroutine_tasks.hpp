@@ -0,0 +1,308 @@
+#ifndef COROUTINE_TASKS_H
+#define COROUTINE_TASKS_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// ------------------------------------------
+// START OF GENERATOR INTERFACE
+// ------------------------------------------
+
+template< typename Ref >
+class Generator
+{
+  public:
+	using value_type = std::remove_cvref_t< Ref >;
+	using reference = std::conditional_t< std::is_reference_v< Ref >, Ref, const Ref& >;
+	using pointer = std::add_pointer_t< std::remove_reference_t< Ref > >;
+
+	class promise_type
+	{
+		friend class Generator;
+
+		pointer value = nullptr;
+		std::exception_ptr error;
+
+	  public:
+		Generator get_return_object() noexcept;
+		std::suspend_always initial_suspend() const noexcept;
+		std::suspend_always final_suspend() const noexcept;
+		std::suspend_always yield_value(std::remove_reference_t< Ref >& value) noexcept;
+		std::suspend_always yield_value(std::remove_reference_t< Ref >&& value) noexcept;
+		void return_void() const noexcept;
+		void unhandled_exception() noexcept;
+
+		template< typename U >
+		std::suspend_never await_transform(U&& value) = delete;
+	};
+
+	class Iterator
+	{
+		std::coroutine_handle< promise_type > handle;
+
+	  public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = Generator::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = Generator::reference;
+
+		Iterator() noexcept = default;
+		explicit Iterator(std::coroutine_handle< promise_type > handle) noexcept;
+
+		reference operator*() const noexcept;
+		Iterator& operator++();
+		void operator++(int);
+
+		bool operator==(std::default_sentinel_t) const noexcept;
+	};
+
+  private:
+	std::coroutine_handle< promise_type > handle;
+
+  public:
+	explicit Generator(std::coroutine_handle< promise_type > handle) noexcept;
+	Generator(const Generator& other) = delete;
+	Generator(Generator&& other) noexcept;
+	~Generator();
+
+	Generator& operator=(const Generator& other) = delete;
+	Generator& operator=(Generator&& other) noexcept;
+
+	Iterator begin();
+	std::default_sentinel_t end() const noexcept;
+
+  private:
+	static void advance(std::coroutine_handle< promise_type > handle);
+};
+
+// ------------------------------------------
+// START OF MAINTENANCE TASK INTERFACE
+// ------------------------------------------
+
+class MaintenanceTask
+{
+  public:
+	using size_type = std::size_t;
+
+	class promise_type
+	{
+		friend class MaintenanceTask;
+
+		size_type progress = 0;
+		std::exception_ptr error;
+
+	  public:
+		MaintenanceTask get_return_object() noexcept;
+		std::suspend_always initial_suspend() const noexcept;
+		std::suspend_always final_suspend() const noexcept;
+		std::suspend_always yield_value(size_type value) noexcept;
+		void return_void() const noexcept;
+		void unhandled_exception() noexcept;
+	};
+
+  private:
+	std::coroutine_handle< promise_type > handle;
+
+  public:
+	explicit MaintenanceTask(std::coroutine_handle< promise_type > handle) noexcept;
+	MaintenanceTask(const MaintenanceTask& other) = delete;
+	MaintenanceTask(MaintenanceTask&& other) noexcept;
+	~MaintenanceTask();
+
+	MaintenanceTask& operator=(const MaintenanceTask& other) = delete;
+	MaintenanceTask& operator=(MaintenanceTask&& other) noexcept;
+
+	bool resume();
+	void run();
+	[[nodiscard]] bool done() const noexcept;
+	[[nodiscard]] size_type progress() const noexcept;
+};
+
+// ------------------------------------------
+// START OF GENERATOR IMPLEMENTATION
+// ------------------------------------------
+
+template< typename Ref >
+Generator< Ref > Generator< Ref >::promise_type::get_return_object() noexcept
+{
+	return Generator(std::coroutine_handle< promise_type >::from_promise(*this));
+}
+template< typename Ref >
+std::suspend_always Generator< Ref >::promise_type::initial_suspend() const noexcept
+{
+	return {};
+}
+template< typename Ref >
+std::suspend_always Generator< Ref >::promise_type::final_suspend() const noexcept
+{
+	return {};
+}
+template< typename Ref >
+std::suspend_always Generator< Ref >::promise_type::yield_value(std::remove_reference_t< Ref >& value) noexcept
+{
+	this->value = std::addressof(value);
+	return {};
+}
+template< typename Ref >
+std::suspend_always Generator< Ref >::promise_type::yield_value(std::remove_reference_t< Ref >&& value) noexcept
+{
+	this->value = std::addressof(value);
+	return {};
+}
+template< typename Ref >
+void Generator< Ref >::promise_type::return_void() const noexcept
+{
+}
+template< typename Ref >
+void Generator< Ref >::promise_type::unhandled_exception() noexcept
+{
+	error = std::current_exception();
+}
+template< typename Ref >
+Generator< Ref >::Iterator::Iterator(std::coroutine_handle< promise_type > handle) noexcept : handle(handle)
+{
+}
+template< typename Ref >
+Generator< Ref >::reference Generator< Ref >::Iterator::operator*() const noexcept
+{
+	return static_cast< reference >(*handle.promise().value);
+}
+template< typename Ref >
+Generator< Ref >::Iterator& Generator< Ref >::Iterator::operator++()
+{
+	advance(handle);
+	return *this;
+}
+template< typename Ref >
+void Generator< Ref >::Iterator::operator++(int)
+{
+	++(*this);
+}
+template< typename Ref >
+bool Generator< Ref >::Iterator::operator==(std::default_sentinel_t) const noexcept
+{
+	return !handle || handle.done();
+}
+template< typename Ref >
+Generator< Ref >::Generator(std::coroutine_handle< promise_type > handle) noexcept : handle(handle)
+{
+}
+template< typename Ref >
+Generator< Ref >::Generator(Generator&& other) noexcept : handle(std::exchange(other.handle, nullptr))
+{
+}
+template< typename Ref >
+Generator< Ref >::~Generator()
+{
+	if (handle)
+		handle.destroy();
+}
+template< typename Ref >
+Generator< Ref >& Generator< Ref >::operator=(Generator&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (handle)
+			handle.destroy();
+		handle = std::exchange(other.handle, nullptr);
+	}
+	return *this;
+}
+template< typename Ref >
+Generator< Ref >::Iterator Generator< Ref >::begin()
+{
+	advance(handle);
+	return Iterator(handle);
+}
+template< typename Ref >
+std::default_sentinel_t Generator< Ref >::end() const noexcept
+{
+	return std::default_sentinel;
+}
+template< typename Ref >
+void Generator< Ref >::advance(std::coroutine_handle< promise_type > handle)
+{
+	if (!handle || handle.done())
+		return;
+
+	handle.resume();
+	if (handle.promise().error)
+		std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+}
+
+// ------------------------------------------
+// START OF MAINTENANCE TASK IMPLEMENTATION
+// ------------------------------------------
+
+inline MaintenanceTask MaintenanceTask::promise_type::get_return_object() noexcept
+{
+	return MaintenanceTask(std::coroutine_handle< promise_type >::from_promise(*this));
+}
+inline std::suspend_always MaintenanceTask::promise_type::initial_suspend() const noexcept
+{
+	return {};
+}
+inline std::suspend_always MaintenanceTask::promise_type::final_suspend() const noexcept
+{
+	return {};
+}
+inline std::suspend_always MaintenanceTask::promise_type::yield_value(size_type value) noexcept
+{
+	progress = value;
+	return {};
+}
+inline void MaintenanceTask::promise_type::return_void() const noexcept {}
+inline void MaintenanceTask::promise_type::unhandled_exception() noexcept
+{
+	error = std::current_exception();
+}
+inline MaintenanceTask::MaintenanceTask(std::coroutine_handle< promise_type > handle) noexcept : handle(handle) {}
+inline MaintenanceTask::MaintenanceTask(MaintenanceTask&& other) noexcept : handle(std::exchange(other.handle, nullptr))
+{
+}
+inline MaintenanceTask::~MaintenanceTask()
+{
+	if (handle)
+		handle.destroy();
+}
+inline MaintenanceTask& MaintenanceTask::operator=(MaintenanceTask&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (handle)
+			handle.destroy();
+		handle = std::exchange(other.handle, nullptr);
+	}
+	return *this;
+}
+inline bool MaintenanceTask::resume()
+{
+	if (done())
+		return false;
+
+	handle.resume();
+	if (handle.promise().error)
+		std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+	return !handle.done();
+}
+inline void MaintenanceTask::run()
+{
+	while (resume())
+	{
+	}
+}
+inline bool MaintenanceTask::done() const noexcept
+{
+	return !handle || handle.done();
+}
+inline MaintenanceTask::size_type MaintenanceTask::progress() const noexcept
+{
+	return handle ? handle.promise().progress : 0;
+}
+
+#endif /* COROUTINE_TASKS_H */
@@ -0,0 +1,445 @@
+#ifndef GROUP_AGGREGATE_H
+#define GROUP_AGGREGATE_H
+
+#include "query_pipeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ------------------------------------------
+// START OF FLAT GROUP TABLE INTERFACE
+// ------------------------------------------
+
+template< typename K, typename A, typename Hash = std::hash< K >, typename KeyEqual = std::equal_to< K > >
+class FlatGroupTable
+{
+  public:
+	using key_type = K;
+	using mapped_type = A;
+	using value_type = std::pair< K, A >;
+	using size_type = std::size_t;
+
+	static constexpr size_type INITIAL_SLOTS = 16;
+
+  private:
+	struct Slot
+	{
+		size_type hash = 0;
+		std::optional< value_type > entry;
+	};
+
+	std::vector< Slot > slots;
+	size_type count = 0;
+	Hash hash;
+	KeyEqual equal;
+
+  public:
+	FlatGroupTable() = default;
+
+	template< typename Make >
+	A& upsert(const K& key, size_type keyHash, Make make);
+	template< typename Merge >
+	void merge(FlatGroupTable&& other, Merge merge);
+
+	[[nodiscard]] const A* find(const K& key, size_type keyHash) const;
+	[[nodiscard]] size_type hashOf(const K& key) const;
+	[[nodiscard]] bool empty() const noexcept;
+	[[nodiscard]] size_type size() const noexcept;
+
+	template< typename F >
+	void for_each(F f) const;
+
+  private:
+	[[nodiscard]] size_type probe(const K& key, size_type keyHash) const;
+	void grow();
+};
+
+// ------------------------------------------
+// START OF GROUP RESULT INTERFACE
+// ------------------------------------------
+
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+class GroupStage;
+
+template< typename K, typename A, typename Hash = std::hash< K >, typename KeyEqual = std::equal_to< K > >
+class GroupResult
+{
+	template< typename, typename, typename, typename, typename >
+	friend class GroupStage;
+
+  public:
+	using table_type = FlatGroupTable< K, A, Hash, KeyEqual >;
+	using size_type = std::size_t;
+
+  private:
+	std::vector< table_type > partitions;
+	size_type radixBits;
+
+  public:
+	explicit GroupResult(size_type radix_bits = 0);
+
+	template< typename Merge >
+	void merge(GroupResult&& other, Merge merge);
+
+	[[nodiscard]] const A* find(const K& key) const;
+	[[nodiscard]] bool empty() const noexcept;
+	[[nodiscard]] size_type size() const noexcept;
+	[[nodiscard]] size_type partition_count() const noexcept;
+
+	template< typename F >
+	void for_each(F f) const;
+
+  private:
+	[[nodiscard]] size_type partitionOf(size_type keyHash) const noexcept;
+};
+
+// ------------------------------------------
+// START OF GROUP STAGE INTERFACE
+// ------------------------------------------
+
+template< typename K, typename A, typename V, typename Hash = std::hash< K >, typename KeyEqual = std::equal_to< K > >
+class GroupStage
+{
+  public:
+	using result_type = GroupResult< K, A, Hash, KeyEqual >;
+	using size_type = std::size_t;
+
+	static constexpr size_type STAGE_CAPACITY = 256;
+
+  private:
+	struct Row
+	{
+		size_type hash;
+		K key;
+		V value;
+	};
+
+	result_type result;
+	std::vector< std::vector< Row > > staged;
+
+  public:
+	explicit GroupStage(size_type radixBits);
+
+	template< typename Agg >
+	void add(const K& key, const V& value, const Agg& agg);
+	template< typename Agg >
+	void merge(GroupStage&& other, const Agg& agg);
+	template< typename Agg >
+	[[nodiscard]] result_type finish(const Agg& agg);
+
+  private:
+	template< typename Agg >
+	void flush(size_type partition, const Agg& agg);
+	template< typename Agg >
+	void flushAll(const Agg& agg);
+};
+
+// ------------------------------------------
+// START OF GROUP SINK INTERFACE
+// ------------------------------------------
+
+template< typename KeyFn, QuerySink Agg >
+class GroupSink
+{
+	KeyFn keyFn;
+	Agg agg;
+	std::size_t radixBits;
+
+  public:
+	using sink_tag = void;
+	using size_type = std::size_t;
+
+	template< typename V >
+	using key_type = std::remove_cvref_t< std::invoke_result_t< const KeyFn&, const V& > >;
+	template< typename V >
+	using mapped_type = decltype(std::declval< const Agg& >().template init< V >());
+	template< typename V >
+	using result_type = GroupStage< key_type< V >, mapped_type< V >, V >;
+
+	static constexpr size_type MAX_RADIX_BITS = 12;
+
+	GroupSink(KeyFn keyFn, Agg agg, size_type radixBits);
+
+	template< typename V >
+	[[nodiscard]] result_type< V > init() const;
+	template< typename V >
+	void accumulate(result_type< V >& result, const V& value) const;
+	template< typename R >
+	[[nodiscard]] R merge(R first, R second) const;
+	template< typename R >
+	[[nodiscard]] auto finish(R result) const;
+};
+
+template< typename KeyFn, QuerySink Agg >
+[[nodiscard]] GroupSink< KeyFn, Agg > query_group_aggregate(KeyFn key_fn, Agg agg, std::size_t radix_bits = 0);
+
+[[nodiscard]] std::size_t mixGroupHash(std::size_t value) noexcept;
+
+// ------------------------------------------
+// START OF FLAT GROUP TABLE IMPLEMENTATION
+// ------------------------------------------
+
+template< typename K, typename A, typename Hash, typename KeyEqual >
+template< typename Make >
+A& FlatGroupTable< K, A, Hash, KeyEqual >::upsert(const K& key, size_type keyHash, Make make)
+{
+	if ((count + 1) * 2 > slots.size())
+		grow();
+
+	Slot& slot = slots[probe(key, keyHash)];
+	if (!slot.entry)
+	{
+		slot.entry.emplace(key, make());
+		slot.hash = keyHash;
+		++count;
+	}
+	return slot.entry->second;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+template< typename Merge >
+void FlatGroupTable< K, A, Hash, KeyEqual >::merge(FlatGroupTable&& other, Merge merge)
+{
+	if (other.size() > size())
+		std::swap(*this, other);
+
+	for (Slot& source : other.slots)
+	{
+		if (!source.entry)
+			continue;
+
+		bool inserted = false;
+		A& value = upsert(source.entry->first,
+						  source.hash,
+						  [&]
+						  {
+							  inserted = true;
+							  return std::move(source.entry->second);
+						  });
+		if (!inserted)
+			value = merge(std::move(value), std::move(source.entry->second));
+	}
+	other = FlatGroupTable();
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+const A* FlatGroupTable< K, A, Hash, KeyEqual >::find(const K& key, size_type keyHash) const
+{
+	if (slots.empty())
+		return nullptr;
+
+	const Slot& slot = slots[probe(key, keyHash)];
+	return slot.entry ? &slot.entry->second : nullptr;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+FlatGroupTable< K, A, Hash, KeyEqual >::size_type FlatGroupTable< K, A, Hash, KeyEqual >::hashOf(const K& key) const
+{
+	return mixGroupHash(hash(key));
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+bool FlatGroupTable< K, A, Hash, KeyEqual >::empty() const noexcept
+{
+	return count == 0;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+FlatGroupTable< K, A, Hash, KeyEqual >::size_type FlatGroupTable< K, A, Hash, KeyEqual >::size() const noexcept
+{
+	return count;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+template< typename F >
+void FlatGroupTable< K, A, Hash, KeyEqual >::for_each(F f) const
+{
+	for (const Slot& slot : slots)
+		if (slot.entry)
+			f(slot.entry->first, slot.entry->second);
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+FlatGroupTable< K, A, Hash, KeyEqual >::size_type FlatGroupTable< K, A, Hash, KeyEqual >::probe(const K& key,
+																								 size_type keyHash) const
+{
+	size_type mask = slots.size() - 1;
+	size_type index = keyHash & mask;
+	while (slots[index].entry && (slots[index].hash != keyHash || !equal(slots[index].entry->first, key)))
+		index = (index + 1) & mask;
+	return index;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+void FlatGroupTable< K, A, Hash, KeyEqual >::grow()
+{
+	std::vector< Slot > grown(slots.empty() ? INITIAL_SLOTS : slots.size() * 2);
+	size_type mask = grown.size() - 1;
+	for (Slot& slot : slots)
+	{
+		if (!slot.entry)
+			continue;
+
+		size_type index = slot.hash & mask;
+		while (grown[index].entry)
+			index = (index + 1) & mask;
+		grown[index] = std::move(slot);
+	}
+	slots.swap(grown);
+}
+
+// ------------------------------------------
+// START OF GROUP RESULT IMPLEMENTATION
+// ------------------------------------------
+
+template< typename K, typename A, typename Hash, typename KeyEqual >
+GroupResult< K, A, Hash, KeyEqual >::GroupResult(size_type radix_bits) :
+	partitions(size_type(1) << radix_bits), radixBits(radix_bits)
+{
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+template< typename Merge >
+void GroupResult< K, A, Hash, KeyEqual >::merge(GroupResult&& other, Merge merge)
+{
+	for (size_type partition = 0; partition < partitions.size(); ++partition)
+		partitions[partition].merge(std::move(other.partitions[partition]), merge);
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+const A* GroupResult< K, A, Hash, KeyEqual >::find(const K& key) const
+{
+	size_type keyHash = partitions.front().hashOf(key);
+	return partitions[partitionOf(keyHash)].find(key, keyHash);
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+bool GroupResult< K, A, Hash, KeyEqual >::empty() const noexcept
+{
+	return size() == 0;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+GroupResult< K, A, Hash, KeyEqual >::size_type GroupResult< K, A, Hash, KeyEqual >::size() const noexcept
+{
+	size_type result = 0;
+	for (const table_type& table : partitions)
+		result += table.size();
+	return result;
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+GroupResult< K, A, Hash, KeyEqual >::size_type GroupResult< K, A, Hash, KeyEqual >::partition_count() const noexcept
+{
+	return partitions.size();
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+template< typename F >
+void GroupResult< K, A, Hash, KeyEqual >::for_each(F f) const
+{
+	for (const table_type& table : partitions)
+		table.for_each(f);
+}
+template< typename K, typename A, typename Hash, typename KeyEqual >
+GroupResult< K, A, Hash, KeyEqual >::size_type GroupResult< K, A, Hash, KeyEqual >::partitionOf(size_type keyHash) const noexcept
+{
+	return radixBits == 0 ? 0 : keyHash >> (sizeof(size_type) * 8 - radixBits);
+}
+
+// ------------------------------------------
+// START OF GROUP STAGE IMPLEMENTATION
+// ------------------------------------------
+
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+GroupStage< K, A, V, Hash, KeyEqual >::GroupStage(size_type radixBits) :
+	result(radixBits), staged(radixBits == 0 ? 0 : result.partition_count())
+{
+	for (std::vector< Row >& rows : staged)
+		rows.reserve(STAGE_CAPACITY);
+}
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+template< typename Agg >
+void GroupStage< K, A, V, Hash, KeyEqual >::add(const K& key, const V& value, const Agg& agg)
+{
+	size_type keyHash = result.partitions.front().hashOf(key);
+	if (staged.empty())
+	{
+		agg.accumulate(result.partitions.front().upsert(key, keyHash, [&agg] { return agg.template init< V >(); }), value);
+		return;
+	}
+
+	size_type partition = result.partitionOf(keyHash);
+	staged[partition].push_back(Row{ keyHash, key, value });
+	if (staged[partition].size() == STAGE_CAPACITY)
+		flush(partition, agg);
+}
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+template< typename Agg >
+void GroupStage< K, A, V, Hash, KeyEqual >::merge(GroupStage&& other, const Agg& agg)
+{
+	flushAll(agg);
+	other.flushAll(agg);
+	result.merge(std::move(other.result), [&agg](A first, A second) { return agg.merge(std::move(first), std::move(second)); });
+}
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+template< typename Agg >
+GroupStage< K, A, V, Hash, KeyEqual >::result_type GroupStage< K, A, V, Hash, KeyEqual >::finish(const Agg& agg)
+{
+	flushAll(agg);
+	return std::move(result);
+}
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+template< typename Agg >
+void GroupStage< K, A, V, Hash, KeyEqual >::flush(size_type partition, const Agg& agg)
+{
+	FlatGroupTable< K, A, Hash, KeyEqual >& table = result.partitions[partition];
+	for (const Row& row : staged[partition])
+		agg.accumulate(table.upsert(row.key, row.hash, [&agg] { return agg.template init< V >(); }), row.value);
+	staged[partition].clear();
+}
+template< typename K, typename A, typename V, typename Hash, typename KeyEqual >
+template< typename Agg >
+void GroupStage< K, A, V, Hash, KeyEqual >::flushAll(const Agg& agg)
+{
+	for (size_type partition = 0; partition < staged.size(); ++partition)
+		flush(partition, agg);
+}
+
+// ------------------------------------------
+// START OF GROUP SINK IMPLEMENTATION
+// ------------------------------------------
+
+template< typename KeyFn, QuerySink Agg >
+GroupSink< KeyFn, Agg >::GroupSink(KeyFn keyFn, Agg agg, size_type radixBits) :
+	keyFn(std::move(keyFn)), agg(std::move(agg)), radixBits(std::min(radixBits, MAX_RADIX_BITS))
+{
+}
+template< typename KeyFn, QuerySink Agg >
+template< typename V >
+GroupSink< KeyFn, Agg >::result_type< V > GroupSink< KeyFn, Agg >::init() const
+{
+	return result_type< V >(radixBits);
+}
+template< typename KeyFn, QuerySink Agg >
+template< typename V >
+void GroupSink< KeyFn, Agg >::accumulate(result_type< V >& result, const V& value) const
+{
+	result.add(std::invoke(keyFn, value), value, agg);
+}
+template< typename KeyFn, QuerySink Agg >
+template< typename R >
+R GroupSink< KeyFn, Agg >::merge(R first, R second) const
+{
+	first.merge(std::move(second), agg);
+	return first;
+}
+template< typename KeyFn, QuerySink Agg >
+template< typename R >
+auto GroupSink< KeyFn, Agg >::finish(R result) const
+{
+	return result.finish(agg);
+}
+template< typename KeyFn, QuerySink Agg >
+GroupSink< KeyFn, Agg > query_group_aggregate(KeyFn key_fn, Agg agg, std::size_t radix_bits)
+{
+	return GroupSink< KeyFn, Agg >(std::move(key_fn), std::move(agg), radix_bits);
+}
+inline std::size_t mixGroupHash(std::size_t value) noexcept
+{
+	uint64_t mixed = uint64_t(value) * 0x9e3779b97f4a7c15ULL;
+	return std::size_t(mixed ^ (mixed >> 29) ^ (mixed >> 47));
+}
+
+#endif /* GROUP_AGGREGATE_H */
@@ -0,0 +1,298 @@
+#ifndef HASH_JOIN_H
+#define HASH_JOIN_H
+
+#include "group_aggregate.hpp"
+#include "query_pipeline.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ------------------------------------------
+// START OF JOIN TABLE INTERFACE
+// ------------------------------------------
+
+template< typename Element, typename KeyFn >
+class JoinTable
+{
+  public:
+	using key_type = std::remove_cvref_t< std::invoke_result_t< const KeyFn&, const Element& > >;
+	using size_type = std::size_t;
+
+	static constexpr size_type MIN_SLOTS = 16;
+
+  private:
+	struct Entry
+	{
+		const Element* element = nullptr;
+		size_type duplicates = 0;
+		key_type key;
+	};
+
+	std::vector< Entry > entries;
+	std::vector< std::pair< const Element*, size_type > > overflow;
+	size_type count;
+	KeyFn keyFn;
+	std::hash< key_type > hash;
+	size_type mask;
+
+  public:
+	template< typename Source >
+	JoinTable(const Source& source, KeyFn keyFn);
+
+	[[nodiscard]] size_type hashOf(const key_type& key) const;
+	void prefetch(size_type keyHash) const noexcept;
+	template< typename F >
+	void forEachMatch(const key_type& key, size_type keyHash, F f) const;
+	[[nodiscard]] size_type size() const noexcept;
+};
+
+// ------------------------------------------
+// START OF JOIN SINK INTERFACE
+// ------------------------------------------
+
+template< typename V, typename Match >
+struct JoinState
+{
+	static constexpr std::size_t PREFETCH_DISTANCE = 16;
+
+	std::array< std::pair< std::size_t, const V* >, PREFETCH_DISTANCE > pending;
+	std::size_t pendingCount = 0;
+	std::vector< Match > batch;
+	std::size_t matches = 0;
+};
+
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+class JoinSink
+{
+	const Table* table;
+	KeyFn keyFn;
+	Emit* emit;
+	std::mutex* emitLock;
+	std::size_t batchSize;
+
+  public:
+	using sink_tag = void;
+	using size_type = std::size_t;
+
+	JoinSink(const Table& table, KeyFn keyFn, Emit& emit, std::mutex& emitLock, size_type batchSize);
+
+	template< typename V >
+	[[nodiscard]] JoinState< V, Match > init() const;
+	template< typename V >
+	void accumulate(JoinState< V, Match >& state, const V& value) const;
+	template< typename V >
+	[[nodiscard]] JoinState< V, Match > merge(JoinState< V, Match > first, JoinState< V, Match > second) const;
+	template< typename V >
+	[[nodiscard]] size_type finish(JoinState< V, Match > state) const;
+
+  private:
+	template< typename V >
+	void drain(JoinState< V, Match >& state) const;
+	template< typename V >
+	void flush(JoinState< V, Match >& state) const;
+};
+
+inline constexpr std::size_t DEFAULT_JOIN_BATCH = 1024;
+
+template< QuerySource Build, QuerySource Probe, typename KeyA, typename KeyB, typename Emit >
+std::size_t query_hash_join(const Build& build,
+							const Probe& probe,
+							KeyA key_a,
+							KeyB key_b,
+							Emit emit,
+							std::size_t batch_size = DEFAULT_JOIN_BATCH);
+
+template< bool Flip, typename Match, typename Small, typename Large, typename KeySmall, typename KeyLarge, typename Emit >
+std::size_t joinSmallerSide(const Small& small, const Large& large, KeySmall keySmall, KeyLarge keyLarge, Emit& emit, std::size_t batchSize);
+
+void prefetchJoinSlot(const void* address) noexcept;
+
+// ------------------------------------------
+// START OF JOIN TABLE IMPLEMENTATION
+// ------------------------------------------
+
+template< typename Element, typename KeyFn >
+template< typename Source >
+JoinTable< Element, KeyFn >::JoinTable(const Source& source, KeyFn keyFn) :
+	count(source.size()), keyFn(std::move(keyFn)), mask(0)
+{
+	size_type slots = MIN_SLOTS;
+	while (slots < count * 2)
+		slots *= 2;
+	mask = slots - 1;
+
+	entries.resize(slots);
+	overflow.emplace_back(nullptr, 0);
+	for (const Element& element : source)
+	{
+		key_type key = std::invoke(this->keyFn, element);
+		size_type slot = hashOf(key) & mask;
+		while (entries[slot].element != nullptr && !(entries[slot].key == key))
+			slot = (slot + 1) & mask;
+
+		Entry& entry = entries[slot];
+		if (entry.element == nullptr)
+		{
+			entry.element = &element;
+			entry.key = std::move(key);
+		}
+		else
+		{
+			overflow.emplace_back(&element, entry.duplicates);
+			entry.duplicates = overflow.size() - 1;
+		}
+	}
+}
+template< typename Element, typename KeyFn >
+JoinTable< Element, KeyFn >::size_type JoinTable< Element, KeyFn >::hashOf(const key_type& key) const
+{
+	return mixGroupHash(hash(key));
+}
+template< typename Element, typename KeyFn >
+void JoinTable< Element, KeyFn >::prefetch(size_type keyHash) const noexcept
+{
+	prefetchJoinSlot(&entries[keyHash & mask]);
+}
+template< typename Element, typename KeyFn >
+template< typename F >
+void JoinTable< Element, KeyFn >::forEachMatch(const key_type& key, size_type keyHash, F f) const
+{
+	size_type slot = keyHash & mask;
+	while (entries[slot].element != nullptr && !(entries[slot].key == key))
+		slot = (slot + 1) & mask;
+	if (entries[slot].element == nullptr)
+		return;
+
+	f(entries[slot].element);
+	for (size_type index = entries[slot].duplicates; index != 0; index = overflow[index].second)
+		f(overflow[index].first);
+}
+template< typename Element, typename KeyFn >
+JoinTable< Element, KeyFn >::size_type JoinTable< Element, KeyFn >::size() const noexcept
+{
+	return count;
+}
+
+// ------------------------------------------
+// START OF JOIN SINK IMPLEMENTATION
+// ------------------------------------------
+
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+JoinSink< Table, KeyFn, Match, Emit, Flip >::JoinSink(const Table& table, KeyFn keyFn, Emit& emit, std::mutex& emitLock, size_type batchSize) :
+	table(&table), keyFn(std::move(keyFn)), emit(&emit), emitLock(&emitLock), batchSize(batchSize == 0 ? 1 : batchSize)
+{
+}
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+template< typename V >
+JoinState< V, Match > JoinSink< Table, KeyFn, Match, Emit, Flip >::init() const
+{
+	JoinState< V, Match > state;
+	state.batch.reserve(batchSize);
+	return state;
+}
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+template< typename V >
+void JoinSink< Table, KeyFn, Match, Emit, Flip >::accumulate(JoinState< V, Match >& state, const V& value) const
+{
+	size_type keyHash = table->hashOf(std::invoke(keyFn, value));
+	table->prefetch(keyHash);
+	state.pending[state.pendingCount++] = { keyHash, &value };
+	if (state.pendingCount == state.pending.size())
+		drain(state);
+}
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+template< typename V >
+JoinState< V, Match > JoinSink< Table, KeyFn, Match, Emit, Flip >::merge(JoinState< V, Match > first, JoinState< V, Match > second) const
+{
+	drain(second);
+	flush(second);
+	first.matches += second.matches;
+	return first;
+}
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+template< typename V >
+JoinSink< Table, KeyFn, Match, Emit, Flip >::size_type JoinSink< Table, KeyFn, Match, Emit, Flip >::finish(JoinState< V, Match > state) const
+{
+	drain(state);
+	flush(state);
+	return state.matches;
+}
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+template< typename V >
+void JoinSink< Table, KeyFn, Match, Emit, Flip >::drain(JoinState< V, Match >& state) const
+{
+	for (size_type i = 0; i < state.pendingCount; ++i)
+	{
+		const V* value = state.pending[i].second;
+		table->forEachMatch(std::invoke(keyFn, *value),
+							state.pending[i].first,
+							[&](const auto* element)
+							{
+								if constexpr (Flip)
+									state.batch.emplace_back(value, element);
+								else
+									state.batch.emplace_back(element, value);
+								++state.matches;
+								if (state.batch.size() == batchSize)
+									flush(state);
+							});
+	}
+	state.pendingCount = 0;
+}
+template< typename Table, typename KeyFn, typename Match, typename Emit, bool Flip >
+template< typename V >
+void JoinSink< Table, KeyFn, Match, Emit, Flip >::flush(JoinState< V, Match >& state) const
+{
+	if (state.batch.empty())
+		return;
+
+	{
+		std::lock_guard< std::mutex > guard(*emitLock);
+		(*emit)(std::span< const Match >(state.batch));
+	}
+	state.batch.clear();
+}
+
+// ------------------------------------------
+// START OF HASH JOIN IMPLEMENTATION
+// ------------------------------------------
+
+template< QuerySource Build, QuerySource Probe, typename KeyA, typename KeyB, typename Emit >
+std::size_t query_hash_join(const Build& build,
+							const Probe& probe,
+							KeyA key_a,
+							KeyB key_b,
+							Emit emit,
+							std::size_t batch_size)
+{
+	using match_type = std::pair< const typename Build::value_type*, const typename Probe::value_type* >;
+
+	if (build.size() <= probe.size())
+		return joinSmallerSide< false, match_type >(build, probe, std::move(key_a), std::move(key_b), emit, batch_size);
+	return joinSmallerSide< true, match_type >(probe, build, std::move(key_b), std::move(key_a), emit, batch_size);
+}
+template< bool Flip, typename Match, typename Small, typename Large, typename KeySmall, typename KeyLarge, typename Emit >
+std::size_t joinSmallerSide(const Small& small, const Large& large, KeySmall keySmall, KeyLarge keyLarge, Emit& emit, std::size_t batchSize)
+{
+	using table_type = JoinTable< typename Small::value_type, KeySmall >;
+
+	table_type table(small, std::move(keySmall));
+	std::mutex emitLock;
+	return large | JoinSink< table_type, KeyLarge, Match, Emit, Flip >(table, std::move(keyLarge), emit, emitLock, batchSize);
+}
+inline void prefetchJoinSlot(const void* address) noexcept
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(address);
+#else
+	static_cast< void >(address);
+#endif
+}
+
+#endif /* HASH_JOIN_H */
@@ -0,0 +1,363 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+// ------------------------------------------
+// START OF LATENCY HISTOGRAM INTERFACE
+// ------------------------------------------
+
+enum class LatencyEvent
+{
+	Insert,
+	Erase,
+	Allocation,
+	Construction,
+	LinkMaintenance,
+	Deallocation,
+	BucketScan,
+	Count
+};
+
+class LatencySnapshot
+{
+  public:
+	using value_type = uint64_t;
+
+	std::vector< value_type > counts;
+	value_type count = 0;
+	value_type sum = 0;
+	value_type max = 0;
+
+	[[nodiscard]] double mean() const noexcept;
+	[[nodiscard]] value_type percentile(double quantile) const noexcept;
+};
+
+class LatencyHistogram
+{
+  public:
+	using value_type = uint64_t;
+	using size_type = std::size_t;
+
+	static constexpr unsigned SUB_BUCKET_BITS = 5;
+	static constexpr size_type SUB_BUCKETS = size_type(1) << SUB_BUCKET_BITS;
+	static constexpr size_type BUCKETS = (65 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+  private:
+	std::array< std::atomic< value_type >, BUCKETS > counts;
+	std::atomic< value_type > count;
+	std::atomic< value_type > sum;
+	std::atomic< value_type > max;
+	std::atomic< value_type > resetRequested;
+	std::atomic< value_type > resetApplied;
+
+  public:
+	LatencyHistogram() noexcept;
+
+	void record(value_type value) noexcept;
+	void reset() noexcept;
+	void addTo(LatencySnapshot& snapshot) const;
+
+	[[nodiscard]] static size_type indexOf(value_type value) noexcept;
+	[[nodiscard]] static value_type upperBound(size_type index) noexcept;
+
+  private:
+	void clear(value_type epoch) noexcept;
+
+	static void add(std::atomic< value_type >& counter, value_type value) noexcept;
+};
+
+class LatencyRegistry
+{
+	struct ThreadHistograms
+	{
+		std::array< LatencyHistogram, size_t(LatencyEvent::Count) > histograms;
+		bool leased = false;
+	};
+
+	mutable std::mutex mutex;
+	std::vector< std::unique_ptr< ThreadHistograms > > threads;
+
+  public:
+	static LatencyRegistry& instance();
+	static void record(LatencyEvent event, uint64_t nanoseconds) noexcept;
+
+	[[nodiscard]] LatencySnapshot snapshot(LatencyEvent event) const;
+	void reset() noexcept;
+	void write(std::ostream& os) const;
+	[[nodiscard]] size_t slots() const;
+
+	[[nodiscard]] static const char* name(LatencyEvent event) noexcept;
+
+  private:
+	[[nodiscard]] static ThreadHistograms* local() noexcept;
+	[[nodiscard]] static bool& localRetired() noexcept;
+	[[nodiscard]] ThreadHistograms* acquire() noexcept;
+	void release(ThreadHistograms* histograms) noexcept;
+};
+
+class LatencyScope
+{
+	using clock = std::chrono::steady_clock;
+
+	LatencyEvent event;
+	clock::time_point start;
+
+  public:
+	constexpr explicit LatencyScope(LatencyEvent event) noexcept;
+	LatencyScope(const LatencyScope& other) = delete;
+	constexpr ~LatencyScope();
+
+	LatencyScope& operator=(const LatencyScope& other) = delete;
+};
+
+// ------------------------------------------
+// START OF LATENCY SNAPSHOT IMPLEMENTATION
+// ------------------------------------------
+
+inline double LatencySnapshot::mean() const noexcept
+{
+	return count == 0 ? 0.0 : double(sum) / double(count);
+}
+inline LatencySnapshot::value_type LatencySnapshot::percentile(double quantile) const noexcept
+{
+	if (count == 0)
+		return 0;
+
+	auto rank = value_type(quantile * double(count - 1)) + 1;
+	value_type seen = 0;
+	for (size_t index = 0; index < counts.size(); ++index)
+	{
+		seen += counts[index];
+		if (seen >= rank)
+			return std::min(LatencyHistogram::upperBound(index), max);
+	}
+	return max;
+}
+
+// ------------------------------------------
+// START OF LATENCY HISTOGRAM IMPLEMENTATION
+// ------------------------------------------
+
+inline LatencyHistogram::LatencyHistogram() noexcept :
+	counts(), count(0), sum(0), max(0), resetRequested(0), resetApplied(0)
+{
+}
+inline void LatencyHistogram::record(value_type value) noexcept
+{
+	value_type epoch = resetRequested.load(std::memory_order_acquire);
+	if (epoch != resetApplied.load(std::memory_order_relaxed))
+		clear(epoch);
+
+	add(counts[indexOf(value)], 1);
+	add(count, 1);
+	add(sum, value);
+	if (value > max.load(std::memory_order_relaxed))
+		max.store(value, std::memory_order_relaxed);
+}
+inline void LatencyHistogram::reset() noexcept
+{
+	resetRequested.fetch_add(1, std::memory_order_release);
+}
+inline void LatencyHistogram::addTo(LatencySnapshot& snapshot) const
+{
+	snapshot.counts.resize(BUCKETS);
+	if (resetRequested.load(std::memory_order_acquire) != resetApplied.load(std::memory_order_acquire))
+		return;
+
+	for (size_type index = 0; index < BUCKETS; ++index)
+		snapshot.counts[index] += counts[index].load(std::memory_order_relaxed);
+	snapshot.count += count.load(std::memory_order_relaxed);
+	snapshot.sum += sum.load(std::memory_order_relaxed);
+	snapshot.max = std::max(snapshot.max, max.load(std::memory_order_relaxed));
+}
+inline LatencyHistogram::size_type LatencyHistogram::indexOf(value_type value) noexcept
+{
+	if (value < SUB_BUCKETS)
+		return size_type(value);
+
+	unsigned exponent = std::bit_width(value) - 1;
+	size_type group = exponent - SUB_BUCKET_BITS + 1;
+	size_type sub = size_type(value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+	return group * SUB_BUCKETS + sub;
+}
+inline LatencyHistogram::value_type LatencyHistogram::upperBound(size_type index) noexcept
+{
+	size_type group = index / SUB_BUCKETS;
+	size_type sub = index % SUB_BUCKETS;
+	if (group == 0)
+		return value_type(sub);
+	return ((value_type(SUB_BUCKETS + sub + 1)) << (group - 1)) - 1;
+}
+inline void LatencyHistogram::clear(value_type epoch) noexcept
+{
+	for (auto& counter : counts)
+		counter.store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+	resetApplied.store(epoch, std::memory_order_release);
+}
+inline void LatencyHistogram::add(std::atomic< value_type >& counter, value_type value) noexcept
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// ------------------------------------------
+// START OF LATENCY REGISTRY IMPLEMENTATION
+// ------------------------------------------
+
+inline LatencyRegistry& LatencyRegistry::instance()
+{
+	static LatencyRegistry* registry = new LatencyRegistry();
+	return *registry;
+}
+inline void LatencyRegistry::record(LatencyEvent event, uint64_t nanoseconds) noexcept
+{
+	if (ThreadHistograms* histograms = local())
+		histograms->histograms[size_t(event)].record(nanoseconds);
+}
+inline LatencySnapshot LatencyRegistry::snapshot(LatencyEvent event) const
+{
+	LatencySnapshot result;
+	result.counts.resize(LatencyHistogram::BUCKETS);
+
+	std::lock_guard< std::mutex > lock(mutex);
+	for (const auto& thread : threads)
+		thread->histograms[size_t(event)].addTo(result);
+	return result;
+}
+inline void LatencyRegistry::reset() noexcept
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	for (const auto& thread : threads)
+		for (auto& histogram : thread->histograms)
+			histogram.reset();
+}
+inline void LatencyRegistry::write(std::ostream& os) const
+{
+	os << std::left << std::setw(18) << "event" << std::right << std::setw(12) << "count" << std::setw(12) << "mean"
+	   << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max" << '\n';
+	for (size_t event = 0; event < size_t(LatencyEvent::Count); ++event)
+	{
+		LatencySnapshot result = snapshot(LatencyEvent(event));
+		if (result.count == 0)
+			continue;
+
+		os << std::left << std::setw(18) << name(LatencyEvent(event)) << std::right << std::setw(12) << result.count
+		   << std::setw(12) << std::fixed << std::setprecision(1) << result.mean() << std::setw(10)
+		   << result.percentile(0.5) << std::setw(10) << result.percentile(0.99) << std::setw(10)
+		   << result.percentile(0.999) << std::setw(12) << result.max << '\n';
+	}
+}
+inline size_t LatencyRegistry::slots() const
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	return threads.size();
+}
+inline const char* LatencyRegistry::name(LatencyEvent event) noexcept
+{
+	switch (event)
+	{
+	case LatencyEvent::Insert:
+		return "insert";
+	case LatencyEvent::Erase:
+		return "erase";
+	case LatencyEvent::Allocation:
+		return "allocation";
+	case LatencyEvent::Construction:
+		return "construction";
+	case LatencyEvent::LinkMaintenance:
+		return "link_maintenance";
+	case LatencyEvent::Deallocation:
+		return "deallocation";
+	case LatencyEvent::BucketScan:
+		return "bucket_scan";
+	default:
+		return "unknown";
+	}
+}
+inline LatencyRegistry::ThreadHistograms* LatencyRegistry::local() noexcept
+{
+	struct Lease
+	{
+		ThreadHistograms* histograms = instance().acquire();
+
+		~Lease()
+		{
+			localRetired() = true;
+			instance().release(histograms);
+		}
+	};
+
+	if (localRetired())
+		return nullptr;
+	thread_local Lease lease;
+	return lease.histograms;
+}
+inline bool& LatencyRegistry::localRetired() noexcept
+{
+	thread_local bool retired = false;
+	return retired;
+}
+inline LatencyRegistry::ThreadHistograms* LatencyRegistry::acquire() noexcept
+{
+	try
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		for (const auto& thread : threads)
+		{
+			if (!thread->leased)
+			{
+				thread->leased = true;
+				return thread.get();
+			}
+		}
+		threads.push_back(std::make_unique< ThreadHistograms >());
+		threads.back()->leased = true;
+		return threads.back().get();
+	} catch (...)
+	{
+		return nullptr;
+	}
+}
+inline void LatencyRegistry::release(ThreadHistograms* histograms) noexcept
+{
+	if (histograms == nullptr)
+		return;
+
+	std::lock_guard< std::mutex > lock(mutex);
+	histograms->leased = false;
+}
+
+// ------------------------------------------
+// START OF LATENCY SCOPE IMPLEMENTATION
+// ------------------------------------------
+
+constexpr LatencyScope::LatencyScope(LatencyEvent event) noexcept : event(event), start()
+{
+	if (!std::is_constant_evaluated())
+		start = clock::now();
+}
+constexpr LatencyScope::~LatencyScope()
+{
+	if (std::is_constant_evaluated())
+		return;
+
+	auto elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(clock::now() - start).count();
+	LatencyRegistry::record(event, uint64_t(elapsed));
+}
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -0,0 +1,447 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ------------------------------------------
+// START OF MEMORY BUDGET INTERFACE
+// ------------------------------------------
+
+class budget_exceeded : public std::bad_alloc
+{
+  public:
+	[[nodiscard]] const char* what() const noexcept override;
+};
+
+class MemoryBudget
+{
+	class Awaiter;
+	class OperationScope;
+
+  public:
+	using size_type = std::size_t;
+	using hook_id = std::size_t;
+	using clock = std::chrono::steady_clock;
+	using awaiter = Awaiter;
+	using operation_scope = OperationScope;
+	using executor_type = std::function< void(std::coroutine_handle<>) >;
+
+	enum class Policy
+	{
+		Fail,
+		Block,
+		Await
+	};
+
+	static constexpr clock::duration DEFAULT_BLOCK_TIMEOUT = std::chrono::seconds(5);
+
+  private:
+	mutable std::mutex mutex;
+	std::condition_variable released;
+	size_type limit;
+	size_type highWaterMark;
+	size_type used;
+	Policy policy;
+	hook_id hookCounter;
+	std::vector< std::pair< hook_id, std::function< void() > > > trimHooks;
+	std::deque< Awaiter* > waiters;
+	std::vector< std::coroutine_handle<> > readyHandles;
+	executor_type executor;
+	std::atomic< bool > trimming;
+	std::atomic< bool > trimPending;
+	clock::duration blockTimeout;
+	std::optional< double > pressureThreshold;
+	std::string pressurePath;
+	clock::duration pressureInterval;
+	clock::time_point lastPressurePoll;
+
+  public:
+	MemoryBudget(size_type limit, size_type highWaterMark, Policy policy = Policy::Fail);
+	MemoryBudget(const MemoryBudget& other) = delete;
+	MemoryBudget& operator=(const MemoryBudget& other) = delete;
+
+	void charge(size_type bytes);
+	void force_charge(size_type bytes) noexcept;
+	void make_room(size_type bytes);
+	void release(size_type bytes) noexcept;
+	[[nodiscard]] awaiter available(size_type bytes = 0);
+	void set_executor(executor_type value);
+	size_type run_ready();
+
+	hook_id add_trim_hook(std::function< void() > hook);
+	void remove_trim_hook(hook_id id);
+	void trim();
+	void set_block_timeout(clock::duration timeout);
+
+	void set_pressure_monitor(double avg10,
+							  clock::duration interval = std::chrono::seconds(1),
+							  std::string path = "/proc/pressure/memory");
+	[[nodiscard]] std::optional< double > read_pressure() const;
+	bool poll_pressure();
+
+	[[nodiscard]] size_type usage() const;
+	[[nodiscard]] size_type capacity() const noexcept;
+	[[nodiscard]] Policy get_policy() const noexcept;
+
+  private:
+	[[nodiscard]] bool fits(size_type bytes) const noexcept;
+	void requestTrim();
+	void beginOperation() noexcept;
+	void endOperation() noexcept;
+	void pollPressureIfDue();
+	void wakeWaiters(std::unique_lock< std::mutex >& lock);
+
+	[[nodiscard]] static size_type& operationDepth() noexcept;
+};
+
+// ------------------------------------------
+// START OF AWAITER INTERFACE
+// ------------------------------------------
+
+class MemoryBudget::Awaiter
+{
+	friend class MemoryBudget;
+
+	MemoryBudget* budget;
+	size_type bytes;
+	std::coroutine_handle<> handle;
+
+  public:
+	Awaiter(MemoryBudget* budget, size_type bytes) noexcept;
+	Awaiter(const Awaiter& other) = delete;
+	~Awaiter();
+
+	Awaiter& operator=(const Awaiter& other) = delete;
+
+	[[nodiscard]] bool await_ready() const;
+	bool await_suspend(std::coroutine_handle<> value);
+	void await_resume() const noexcept;
+};
+
+// ------------------------------------------
+// START OF OPERATION SCOPE INTERFACE
+// ------------------------------------------
+
+class MemoryBudget::OperationScope
+{
+	MemoryBudget* budget;
+
+  public:
+	constexpr explicit OperationScope(MemoryBudget* budget) noexcept;
+	OperationScope(const OperationScope& other) = delete;
+	constexpr ~OperationScope();
+
+	OperationScope& operator=(const OperationScope& other) = delete;
+};
+
+// ------------------------------------------
+// START OF MEMORY BUDGET IMPLEMENTATION
+// ------------------------------------------
+
+inline const char* budget_exceeded::what() const noexcept
+{
+	return "memory budget exceeded";
+}
+inline MemoryBudget::MemoryBudget(size_type limit, size_type highWaterMark, Policy policy) :
+	limit(limit), highWaterMark(highWaterMark), used(0), policy(policy), hookCounter(0), trimming(false),
+	trimPending(false), blockTimeout(DEFAULT_BLOCK_TIMEOUT), pressureInterval(clock::duration::zero())
+{
+}
+inline void MemoryBudget::charge(size_type bytes)
+{
+	pollPressureIfDue();
+
+	std::unique_lock< std::mutex > lock(mutex);
+	if (!fits(bytes))
+	{
+		lock.unlock();
+		requestTrim();
+		lock.lock();
+
+		if (policy == Policy::Block)
+		{
+			if (!released.wait_for(lock, blockTimeout, [this, bytes] { return fits(bytes); }))
+				throw budget_exceeded();
+		}
+		else if (!fits(bytes))
+			throw budget_exceeded();
+	}
+
+	used += bytes;
+	bool high = used > highWaterMark;
+	lock.unlock();
+
+	if (high)
+		requestTrim();
+}
+inline void MemoryBudget::force_charge(size_type bytes) noexcept
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	used += bytes;
+}
+inline void MemoryBudget::make_room(size_type bytes)
+{
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		if (fits(bytes))
+			return;
+	}
+	if (operationDepth() > 1)
+		return;
+
+	trimPending = false;
+	trim();
+}
+inline void MemoryBudget::release(size_type bytes) noexcept
+{
+	std::unique_lock< std::mutex > lock(mutex);
+	used -= std::min(bytes, used);
+	released.notify_all();
+	wakeWaiters(lock);
+}
+inline MemoryBudget::awaiter MemoryBudget::available(size_type bytes)
+{
+	return Awaiter(this, bytes);
+}
+inline void MemoryBudget::set_executor(executor_type value)
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	executor = std::move(value);
+}
+inline MemoryBudget::size_type MemoryBudget::run_ready()
+{
+	std::vector< std::coroutine_handle<> > ready;
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		ready.swap(readyHandles);
+	}
+
+	for (auto handle : ready)
+		handle.resume();
+	return ready.size();
+}
+inline MemoryBudget::hook_id MemoryBudget::add_trim_hook(std::function< void() > hook)
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	trimHooks.emplace_back(hookCounter, std::move(hook));
+	return hookCounter++;
+}
+inline void MemoryBudget::remove_trim_hook(hook_id id)
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	std::erase_if(trimHooks, [id](const auto& hook) { return hook.first == id; });
+}
+inline void MemoryBudget::trim()
+{
+	if (trimming.exchange(true))
+		return;
+
+	std::vector< std::pair< hook_id, std::function< void() > > > hooks;
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		hooks = trimHooks;
+	}
+
+	try
+	{
+		for (auto& hook : hooks)
+			hook.second();
+	} catch (...)
+	{
+		trimming = false;
+		throw;
+	}
+	trimming = false;
+}
+inline void MemoryBudget::set_block_timeout(clock::duration timeout)
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	blockTimeout = timeout;
+}
+inline void MemoryBudget::set_pressure_monitor(double avg10, clock::duration interval, std::string path)
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	pressureThreshold = avg10;
+	pressureInterval = interval;
+	pressurePath = std::move(path);
+	lastPressurePoll = clock::time_point();
+}
+inline std::optional< double > MemoryBudget::read_pressure() const
+{
+	std::string path;
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		path = pressurePath.empty() ? "/proc/pressure/memory" : pressurePath;
+	}
+
+	std::ifstream file(path);
+	std::string kind;
+	std::string avg10;
+	if (!(file >> kind >> avg10) || kind != "some" || avg10.rfind("avg10=", 0) != 0)
+		return std::nullopt;
+
+	try
+	{
+		return std::stod(avg10.substr(6));
+	} catch (const std::exception&)
+	{
+		return std::nullopt;
+	}
+}
+inline bool MemoryBudget::poll_pressure()
+{
+	std::optional< double > threshold;
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		threshold = pressureThreshold;
+		lastPressurePoll = clock::now();
+	}
+	if (!threshold)
+		return false;
+
+	std::optional< double > pressure = read_pressure();
+	if (!pressure || *pressure < *threshold)
+		return false;
+
+	requestTrim();
+	return true;
+}
+inline MemoryBudget::size_type MemoryBudget::usage() const
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	return used;
+}
+inline MemoryBudget::size_type MemoryBudget::capacity() const noexcept
+{
+	return limit;
+}
+inline MemoryBudget::Policy MemoryBudget::get_policy() const noexcept
+{
+	return policy;
+}
+inline bool MemoryBudget::fits(size_type bytes) const noexcept
+{
+	return used + bytes <= limit;
+}
+inline void MemoryBudget::requestTrim()
+{
+	if (operationDepth() == 0)
+		trim();
+	else
+		trimPending = true;
+}
+inline void MemoryBudget::beginOperation() noexcept
+{
+	++operationDepth();
+}
+inline void MemoryBudget::endOperation() noexcept
+{
+	if (--operationDepth() != 0 || !trimPending.exchange(false))
+		return;
+
+	try
+	{
+		trim();
+	} catch (...)
+	{
+	}
+}
+inline void MemoryBudget::pollPressureIfDue()
+{
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		if (!pressureThreshold || clock::now() - lastPressurePoll < pressureInterval)
+			return;
+	}
+	poll_pressure();
+}
+inline void MemoryBudget::wakeWaiters(std::unique_lock< std::mutex >& lock)
+{
+	std::vector< std::coroutine_handle<> > ready;
+	size_type planned = used;
+	while (!waiters.empty() && planned + waiters.front()->bytes <= limit)
+	{
+		planned += waiters.front()->bytes;
+		ready.push_back(waiters.front()->handle);
+		waiters.pop_front();
+	}
+
+	if (!executor)
+	{
+		readyHandles.insert(readyHandles.end(), ready.begin(), ready.end());
+		return;
+	}
+
+	executor_type post = executor;
+	lock.unlock();
+	for (auto handle : ready)
+		post(handle);
+}
+inline MemoryBudget::size_type& MemoryBudget::operationDepth() noexcept
+{
+	thread_local size_type depth = 0;
+	return depth;
+}
+
+// ------------------------------------------
+// START OF AWAITER IMPLEMENTATION
+// ------------------------------------------
+
+inline MemoryBudget::Awaiter::Awaiter(MemoryBudget* budget, size_type bytes) noexcept : budget(budget), bytes(bytes)
+{
+}
+inline MemoryBudget::Awaiter::~Awaiter()
+{
+	if (!handle)
+		return;
+
+	std::lock_guard< std::mutex > lock(budget->mutex);
+	std::erase(budget->waiters, this);
+	std::erase(budget->readyHandles, handle);
+}
+inline bool MemoryBudget::Awaiter::await_ready() const
+{
+	std::lock_guard< std::mutex > lock(budget->mutex);
+	return budget->waiters.empty() && budget->fits(bytes);
+}
+inline bool MemoryBudget::Awaiter::await_suspend(std::coroutine_handle<> value)
+{
+	std::lock_guard< std::mutex > lock(budget->mutex);
+	if (budget->waiters.empty() && budget->fits(bytes))
+		return false;
+
+	handle = value;
+	budget->waiters.push_back(this);
+	return true;
+}
+inline void MemoryBudget::Awaiter::await_resume() const noexcept {}
+
+// ------------------------------------------
+// START OF OPERATION SCOPE IMPLEMENTATION
+// ------------------------------------------
+
+constexpr MemoryBudget::OperationScope::OperationScope(MemoryBudget* budget) noexcept : budget(budget)
+{
+	if (budget != nullptr)
+		budget->beginOperation();
+}
+constexpr MemoryBudget::OperationScope::~OperationScope()
+{
+	if (budget != nullptr)
+		budget->endOperation();
+}
+
+#endif /* MEMORY_BUDGET_H */
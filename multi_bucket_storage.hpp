@@ -0,0 +1,265 @@
+#ifndef MULTI_BUCKET_STORAGE_H
+#define MULTI_BUCKET_STORAGE_H
+
+#include "bucket_storage.hpp"
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+// ------------------------------------------
+// START OF MULTI BUCKET STORAGE INTERFACE
+// ------------------------------------------
+
+template< typename... Ts >
+class MultiBucketStorage
+{
+	static_assert(sizeof...(Ts) > 0, "MultiBucketStorage needs at least one type");
+
+	class Handle;
+
+  public:
+	using size_type = std::size_t;
+	using handle = Handle;
+
+	template< typename U >
+	static constexpr size_type index_of = [] {
+		constexpr bool matches[] = { std::is_same_v< U, Ts >... };
+		size_type result = sizeof...(Ts);
+		for (size_type i = 0; i < sizeof...(Ts); ++i)
+		{
+			if (matches[i])
+			{
+				if (result != sizeof...(Ts))
+					return size_type(sizeof...(Ts) + 1);
+				result = i;
+			}
+		}
+		return result;
+	}();
+
+	template< typename U >
+	static constexpr bool holds_type = index_of< U > < sizeof...(Ts);
+
+  private:
+	std::tuple< BucketStorage< Ts >... > storages;
+
+  public:
+	MultiBucketStorage() = default;
+	explicit MultiBucketStorage(size_type block_capacity);
+
+	template< typename U >
+	handle insert(U&& value);
+	void erase(handle h);
+
+	template< typename U >
+	[[nodiscard]] BucketStorage< U >& of() noexcept;
+	template< typename U >
+	[[nodiscard]] const BucketStorage< U >& of() const noexcept;
+
+	template< typename U >
+	[[nodiscard]] U& get(handle h);
+	template< typename U >
+	[[nodiscard]] const U& get(handle h) const;
+	template< typename F >
+	decltype(auto) visit(handle h, F f);
+	template< typename F >
+	decltype(auto) visit(handle h, F f) const;
+
+	template< typename F >
+	void for_each(F f);
+	template< typename F >
+	void for_each(F f) const;
+
+	[[nodiscard]] bool empty() const noexcept;
+	[[nodiscard]] size_type size() const noexcept;
+	[[nodiscard]] size_type capacity() const noexcept;
+	[[nodiscard]] size_type memory_usage() const;
+
+	void clear();
+	void shrink_to_fit();
+	void set_parallelism(size_type threads) noexcept;
+	void swap(MultiBucketStorage& other) noexcept;
+};
+
+// ------------------------------------------
+// START OF MULTI BUCKET HANDLE INTERFACE
+// ------------------------------------------
+
+template< typename... Ts >
+class MultiBucketStorage< Ts... >::Handle
+{
+	friend class MultiBucketStorage;
+
+	std::variant< typename BucketStorage< Ts >::iterator... > position;
+
+  public:
+	Handle() = default;
+
+	[[nodiscard]] size_type type_index() const noexcept;
+	template< typename U >
+	[[nodiscard]] bool holds() const noexcept;
+
+	bool operator==(const Handle& other) const = default;
+
+  private:
+	template< typename Iterator >
+	explicit Handle(Iterator it);
+};
+
+// ------------------------------------------
+// START OF MULTI BUCKET STORAGE IMPLEMENTATION
+// ------------------------------------------
+
+template< typename... Ts >
+MultiBucketStorage< Ts... >::MultiBucketStorage(size_type block_capacity) :
+	storages(BucketStorage< Ts >(block_capacity)...)
+{
+}
+template< typename... Ts >
+template< typename U >
+MultiBucketStorage< Ts... >::handle MultiBucketStorage< Ts... >::insert(U&& value)
+{
+	return Handle(of< std::remove_cvref_t< U > >().insert(std::forward< U >(value)));
+}
+template< typename... Ts >
+void MultiBucketStorage< Ts... >::erase(handle h)
+{
+	std::visit([this](auto it) { of< typename decltype(it)::value_type >().erase(it); }, h.position);
+}
+template< typename... Ts >
+template< typename U >
+BucketStorage< U >& MultiBucketStorage< Ts... >::of() noexcept
+{
+	static_assert(holds_type< U >, "U must be exactly one of the stored types");
+	return std::get< index_of< U > >(storages);
+}
+template< typename... Ts >
+template< typename U >
+const BucketStorage< U >& MultiBucketStorage< Ts... >::of() const noexcept
+{
+	static_assert(holds_type< U >, "U must be exactly one of the stored types");
+	return std::get< index_of< U > >(storages);
+}
+template< typename... Ts >
+template< typename U >
+U& MultiBucketStorage< Ts... >::get(handle h)
+{
+	return *std::get< index_of< U > >(h.position);
+}
+template< typename... Ts >
+template< typename U >
+const U& MultiBucketStorage< Ts... >::get(handle h) const
+{
+	return *std::get< index_of< U > >(h.position);
+}
+template< typename... Ts >
+template< typename F >
+decltype(auto) MultiBucketStorage< Ts... >::visit(handle h, F f)
+{
+	return std::visit([&f](auto it) -> decltype(auto) { return f(*it); }, h.position);
+}
+template< typename... Ts >
+template< typename F >
+decltype(auto) MultiBucketStorage< Ts... >::visit(handle h, F f) const
+{
+	return std::visit([&f](auto it) -> decltype(auto) { return f(std::as_const(*it)); }, h.position);
+}
+template< typename... Ts >
+template< typename F >
+void MultiBucketStorage< Ts... >::for_each(F f)
+{
+	std::apply(
+		[&f](auto&... storage)
+		{
+			auto scan = [&f](auto& chain)
+			{
+				for (auto& value : chain)
+					f(value);
+			};
+			(scan(storage), ...);
+		},
+		storages);
+}
+template< typename... Ts >
+template< typename F >
+void MultiBucketStorage< Ts... >::for_each(F f) const
+{
+	std::apply(
+		[&f](const auto&... storage)
+		{
+			auto scan = [&f](const auto& chain)
+			{
+				for (const auto& value : chain)
+					f(value);
+			};
+			(scan(storage), ...);
+		},
+		storages);
+}
+template< typename... Ts >
+bool MultiBucketStorage< Ts... >::empty() const noexcept
+{
+	return std::apply([](const auto&... storage) { return (storage.empty() && ...); }, storages);
+}
+template< typename... Ts >
+MultiBucketStorage< Ts... >::size_type MultiBucketStorage< Ts... >::size() const noexcept
+{
+	return std::apply([](const auto&... storage) { return (storage.size() + ...); }, storages);
+}
+template< typename... Ts >
+MultiBucketStorage< Ts... >::size_type MultiBucketStorage< Ts... >::capacity() const noexcept
+{
+	return std::apply([](const auto&... storage) { return (storage.capacity() + ...); }, storages);
+}
+template< typename... Ts >
+MultiBucketStorage< Ts... >::size_type MultiBucketStorage< Ts... >::memory_usage() const
+{
+	return std::apply([](const auto&... storage) { return (storage.memory_usage() + ...); }, storages);
+}
+template< typename... Ts >
+void MultiBucketStorage< Ts... >::clear()
+{
+	std::apply([](auto&... storage) { (storage.clear(), ...); }, storages);
+}
+template< typename... Ts >
+void MultiBucketStorage< Ts... >::shrink_to_fit()
+{
+	std::apply([](auto&... storage) { (storage.shrink_to_fit(), ...); }, storages);
+}
+template< typename... Ts >
+void MultiBucketStorage< Ts... >::set_parallelism(size_type threads) noexcept
+{
+	std::apply([threads](auto&... storage) { (storage.set_parallelism(threads), ...); }, storages);
+}
+template< typename... Ts >
+void MultiBucketStorage< Ts... >::swap(MultiBucketStorage& other) noexcept
+{
+	[this, &other]< size_type... I >(std::index_sequence< I... >)
+	{ (std::get< I >(storages).swap(std::get< I >(other.storages)), ...); }(std::index_sequence_for< Ts... >());
+}
+
+// ------------------------------------------
+// START OF MULTI BUCKET HANDLE IMPLEMENTATION
+// ------------------------------------------
+
+template< typename... Ts >
+template< typename Iterator >
+MultiBucketStorage< Ts... >::Handle::Handle(Iterator it) : position(it)
+{
+}
+template< typename... Ts >
+MultiBucketStorage< Ts... >::size_type MultiBucketStorage< Ts... >::Handle::type_index() const noexcept
+{
+	return position.index();
+}
+template< typename... Ts >
+template< typename U >
+bool MultiBucketStorage< Ts... >::Handle::holds() const noexcept
+{
+	return position.index() == index_of< U >;
+}
+
+#endif /* MULTI_BUCKET_STORAGE_H */
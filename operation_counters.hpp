@@ -0,0 +1,56 @@
+#ifndef OPERATION_COUNTERS_H
+#define OPERATION_COUNTERS_H
+
+#include <cstdint>
+
+// ------------------------------------------
+// START OF OPERATION COUNTERS INTERFACE
+// ------------------------------------------
+
+struct OperationCounters
+{
+	using value_type = uint64_t;
+
+	value_type bucketTraversals = 0;
+	value_type slotTraversals = 0;
+	value_type metadataWrites = 0;
+	value_type allocations = 0;
+	value_type deallocations = 0;
+
+	static OperationCounters& local() noexcept;
+
+	void reset() noexcept;
+	[[nodiscard]] value_type traversals() const noexcept;
+
+	friend OperationCounters operator-(const OperationCounters& first, const OperationCounters& second) noexcept;
+};
+
+// ------------------------------------------
+// START OF OPERATION COUNTERS IMPLEMENTATION
+// ------------------------------------------
+
+inline OperationCounters& OperationCounters::local() noexcept
+{
+	thread_local OperationCounters counters;
+	return counters;
+}
+inline void OperationCounters::reset() noexcept
+{
+	*this = OperationCounters();
+}
+inline OperationCounters::value_type OperationCounters::traversals() const noexcept
+{
+	return bucketTraversals + slotTraversals;
+}
+inline OperationCounters operator-(const OperationCounters& first, const OperationCounters& second) noexcept
+{
+	OperationCounters result;
+	result.bucketTraversals = first.bucketTraversals - second.bucketTraversals;
+	result.slotTraversals = first.slotTraversals - second.slotTraversals;
+	result.metadataWrites = first.metadataWrites - second.metadataWrites;
+	result.allocations = first.allocations - second.allocations;
+	result.deallocations = first.deallocations - second.deallocations;
+	return result;
+}
+
+#endif /* OPERATION_COUNTERS_H */
@@ -0,0 +1,169 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ------------------------------------------
+// START OF PERF COUNTERS INTERFACE
+// ------------------------------------------
+
+class PerfCounters
+{
+  public:
+	enum Counter
+	{
+		Cycles,
+		Instructions,
+		L1DMisses,
+		LLCMisses,
+		DTLBMisses,
+		BranchMisses,
+		Count
+	};
+
+	using values_type = std::array< std::optional< uint64_t >, Count >;
+
+  private:
+	std::array< int, Count > descriptors;
+	std::array< bool, Count > multiplexed;
+
+  public:
+	PerfCounters() noexcept;
+	PerfCounters(const PerfCounters& other) = delete;
+	~PerfCounters();
+
+	PerfCounters& operator=(const PerfCounters& other) = delete;
+
+	[[nodiscard]] bool available() const noexcept;
+	void start() noexcept;
+	[[nodiscard]] values_type stop() noexcept;
+	[[nodiscard]] bool scaled(Counter counter) const noexcept;
+
+	[[nodiscard]] static const char* name(Counter counter) noexcept;
+
+  private:
+	static int open(uint32_t type, uint64_t config) noexcept;
+};
+
+// ------------------------------------------
+// START OF PERF COUNTERS IMPLEMENTATION
+// ------------------------------------------
+
+inline PerfCounters::PerfCounters() noexcept : descriptors(), multiplexed()
+{
+	descriptors.fill(-1);
+#if defined(__linux__)
+	auto cache = [](uint64_t cache, uint64_t op, uint64_t result) { return cache | (op << 8) | (result << 16); };
+
+	descriptors[Cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	descriptors[Instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	descriptors[L1DMisses] = open(
+		PERF_TYPE_HW_CACHE,
+		cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+	descriptors[LLCMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	descriptors[DTLBMisses] = open(
+		PERF_TYPE_HW_CACHE,
+		cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+	descriptors[BranchMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+}
+inline PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+	for (int descriptor : descriptors)
+		if (descriptor >= 0)
+			close(descriptor);
+#endif
+}
+inline bool PerfCounters::available() const noexcept
+{
+	for (int descriptor : descriptors)
+		if (descriptor >= 0)
+			return true;
+	return false;
+}
+inline void PerfCounters::start() noexcept
+{
+#if defined(__linux__)
+	for (int descriptor : descriptors)
+		if (descriptor >= 0)
+			ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+	prctl(PR_TASK_PERF_EVENTS_ENABLE, 0, 0, 0, 0);
+#endif
+}
+inline PerfCounters::values_type PerfCounters::stop() noexcept
+{
+	values_type values;
+#if defined(__linux__)
+	prctl(PR_TASK_PERF_EVENTS_DISABLE, 0, 0, 0, 0);
+
+	for (size_t counter = 0; counter < Count; ++counter)
+	{
+		multiplexed[counter] = false;
+		uint64_t reading[3] = {};
+		if (descriptors[counter] < 0 || read(descriptors[counter], reading, sizeof(reading)) != sizeof(reading) ||
+			reading[2] == 0)
+			continue;
+
+		multiplexed[counter] = reading[2] < reading[1];
+		values[counter] = multiplexed[counter] ? uint64_t(double(reading[0]) * double(reading[1]) / double(reading[2]))
+											   : reading[0];
+	}
+#endif
+	return values;
+}
+inline bool PerfCounters::scaled(Counter counter) const noexcept
+{
+	return multiplexed[counter];
+}
+inline const char* PerfCounters::name(Counter counter) noexcept
+{
+	switch (counter)
+	{
+	case Cycles:
+		return "cycles";
+	case Instructions:
+		return "instructions";
+	case L1DMisses:
+		return "L1d-misses";
+	case LLCMisses:
+		return "LLC-misses";
+	case DTLBMisses:
+		return "dTLB-misses";
+	case BranchMisses:
+		return "branch-misses";
+	default:
+		return "unknown";
+	}
+}
+inline int PerfCounters::open(uint32_t type, uint64_t config) noexcept
+{
+#if defined(__linux__)
+	perf_event_attr attributes{};
+	attributes.size = sizeof(attributes);
+	attributes.type = type;
+	attributes.config = config;
+	attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attributes.disabled = 1;
+	attributes.inherit = 1;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	return int(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#else
+	(void)type;
+	(void)config;
+	return -1;
+#endif
+}
+
+#endif /* PERF_COUNTERS_H */
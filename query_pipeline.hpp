@@ -0,0 +1,359 @@
+#ifndef QUERY_PIPELINE_H
+#define QUERY_PIPELINE_H
+
+#include "bucket_storage.hpp"
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// ------------------------------------------
+// START OF QUERY PIPELINE INTERFACE
+// ------------------------------------------
+
+template< typename S >
+concept QueryStage = requires { typename S::stage_tag; };
+
+template< typename S >
+concept QuerySink = requires { typename S::sink_tag; };
+
+template< typename S >
+concept QuerySource = std::same_as< S, BucketStorage< typename S::value_type > > ||
+					  std::same_as< S, typename BucketStorage< typename S::value_type >::frozen_storage >;
+
+template< typename Predicate >
+class WhereStage
+{
+	Predicate predicate;
+
+  public:
+	using stage_tag = void;
+
+	template< typename In >
+	using output = In;
+
+	explicit WhereStage(Predicate predicate);
+
+	template< typename In, typename Next >
+	[[nodiscard]] auto bind(Next next) const;
+};
+
+template< typename F >
+class SelectStage
+{
+	F f;
+
+  public:
+	using stage_tag = void;
+
+	template< typename In >
+	using output = std::remove_cvref_t< std::invoke_result_t< const F&, const In& > >;
+
+	explicit SelectStage(F f);
+
+	template< typename In, typename Next >
+	[[nodiscard]] auto bind(Next next) const;
+};
+
+class SumSink
+{
+  public:
+	using sink_tag = void;
+
+	template< typename V >
+	[[nodiscard]] V init() const;
+	template< typename V >
+	void accumulate(V& result, const V& value) const;
+	template< typename V >
+	[[nodiscard]] V merge(V first, V second) const;
+};
+
+class CountSink
+{
+  public:
+	using sink_tag = void;
+	using size_type = std::size_t;
+
+	template< typename V >
+	[[nodiscard]] size_type init() const noexcept;
+	template< typename V >
+	void accumulate(size_type& result, const V& value) const noexcept;
+	[[nodiscard]] size_type merge(size_type first, size_type second) const noexcept;
+};
+
+template< typename R, typename Op >
+class ReduceSink
+{
+	R initial;
+	Op op;
+
+  public:
+	using sink_tag = void;
+
+	ReduceSink(R initial, Op op);
+
+	template< typename V >
+	[[nodiscard]] R init() const;
+	template< typename V >
+	void accumulate(R& result, const V& value) const;
+	[[nodiscard]] R merge(R first, R second) const;
+};
+
+template< typename In, typename... Stages >
+struct PipelineOutput
+{
+	using type = In;
+};
+
+template< typename In, typename Stage, typename... Stages >
+struct PipelineOutput< In, Stage, Stages... >
+{
+	using type = typename PipelineOutput< typename Stage::template output< In >, Stages... >::type;
+};
+
+template< typename Source, typename... Stages >
+class Query
+{
+	const Source* source;
+	std::tuple< Stages... > stages;
+
+  public:
+	using value_type = typename PipelineOutput< typename Source::value_type, Stages... >::type;
+
+	Query(const Source& source, std::tuple< Stages... > stages);
+
+	template< QueryStage Stage >
+	[[nodiscard]] Query< Source, Stages..., Stage > then(Stage stage) const;
+	template< QuerySink Sink >
+	[[nodiscard]] auto run(const Sink& sink) const;
+
+  private:
+	template< std::size_t I, typename In, typename Consumer >
+	[[nodiscard]] auto bind(Consumer consumer) const;
+
+	template< typename F >
+	static void scan(const typename BucketStorage< typename Source::value_type >::bucket_view& bucket, F& f);
+	template< typename F >
+	static void scan(std::span< const typename Source::value_type > bucket, F& f);
+};
+
+template< typename Predicate >
+[[nodiscard]] WhereStage< Predicate > query_where(Predicate predicate);
+template< typename F >
+[[nodiscard]] SelectStage< F > query_select(F f);
+[[nodiscard]] SumSink query_sum() noexcept;
+[[nodiscard]] CountSink query_count() noexcept;
+template< typename R, typename Op >
+[[nodiscard]] ReduceSink< R, Op > query_reduce(R init, Op op);
+
+template< QuerySource Source, QueryStage Stage >
+[[nodiscard]] Query< Source, Stage > operator|(const Source& source, Stage stage);
+template< QuerySource Source, QueryStage Stage >
+void operator|(const Source&& source, Stage stage) = delete;
+template< QuerySource Source, QuerySink Sink >
+[[nodiscard]] auto operator|(const Source& source, const Sink& sink);
+template< typename Source, typename... Stages, QueryStage Stage >
+[[nodiscard]] Query< Source, Stages..., Stage > operator|(const Query< Source, Stages... >& query, Stage stage);
+template< typename Source, typename... Stages, QuerySink Sink >
+[[nodiscard]] auto operator|(const Query< Source, Stages... >& query, const Sink& sink);
+
+// ------------------------------------------
+// START OF QUERY STAGES IMPLEMENTATION
+// ------------------------------------------
+
+template< typename Predicate >
+WhereStage< Predicate >::WhereStage(Predicate predicate) : predicate(std::move(predicate))
+{
+}
+template< typename Predicate >
+template< typename In, typename Next >
+auto WhereStage< Predicate >::bind(Next next) const
+{
+	return [predicate = predicate, next = std::move(next)](const In& value) mutable
+	{
+		if (std::invoke(predicate, value))
+			next(value);
+	};
+}
+template< typename F >
+SelectStage< F >::SelectStage(F f) : f(std::move(f))
+{
+}
+template< typename F >
+template< typename In, typename Next >
+auto SelectStage< F >::bind(Next next) const
+{
+	return [f = f, next = std::move(next)](const In& value) mutable { next(std::invoke(f, value)); };
+}
+
+// ------------------------------------------
+// START OF QUERY SINKS IMPLEMENTATION
+// ------------------------------------------
+
+template< typename V >
+V SumSink::init() const
+{
+	return V();
+}
+template< typename V >
+void SumSink::accumulate(V& result, const V& value) const
+{
+	result += value;
+}
+template< typename V >
+V SumSink::merge(V first, V second) const
+{
+	first += second;
+	return first;
+}
+template< typename V >
+CountSink::size_type CountSink::init() const noexcept
+{
+	return 0;
+}
+template< typename V >
+void CountSink::accumulate(size_type& result, const V&) const noexcept
+{
+	++result;
+}
+inline CountSink::size_type CountSink::merge(size_type first, size_type second) const noexcept
+{
+	return first + second;
+}
+template< typename R, typename Op >
+ReduceSink< R, Op >::ReduceSink(R initial, Op op) : initial(std::move(initial)), op(std::move(op))
+{
+}
+template< typename R, typename Op >
+template< typename V >
+R ReduceSink< R, Op >::init() const
+{
+	return initial;
+}
+template< typename R, typename Op >
+template< typename V >
+void ReduceSink< R, Op >::accumulate(R& result, const V& value) const
+{
+	result = std::invoke(op, std::move(result), value);
+}
+template< typename R, typename Op >
+R ReduceSink< R, Op >::merge(R first, R second) const
+{
+	return std::invoke(op, std::move(first), std::move(second));
+}
+
+// ------------------------------------------
+// START OF QUERY IMPLEMENTATION
+// ------------------------------------------
+
+template< typename Source, typename... Stages >
+Query< Source, Stages... >::Query(const Source& source, std::tuple< Stages... > stages) :
+	source(&source), stages(std::move(stages))
+{
+}
+template< typename Source, typename... Stages >
+template< QueryStage Stage >
+Query< Source, Stages..., Stage > Query< Source, Stages... >::then(Stage stage) const
+{
+	return Query< Source, Stages..., Stage >(*source, std::tuple_cat(stages, std::make_tuple(std::move(stage))));
+}
+template< typename Source, typename... Stages >
+template< QuerySink Sink >
+auto Query< Source, Stages... >::run(const Sink& sink) const
+{
+	using result_type = decltype(sink.template init< value_type >());
+
+	result_type result = source->fold_buckets(
+		[&sink] { return sink.template init< value_type >(); },
+		[this, &sink](result_type& result, const auto& bucket)
+		{
+			auto kernel = bind< 0, typename Source::value_type >([&result, &sink](const value_type& value)
+																 { sink.accumulate(result, value); });
+			scan(bucket, kernel);
+		},
+		[&sink](result_type first, result_type second) { return sink.merge(std::move(first), std::move(second)); });
+	if constexpr (requires { sink.finish(std::move(result)); })
+		return sink.finish(std::move(result));
+	else
+		return result;
+}
+template< typename Source, typename... Stages >
+template< std::size_t I, typename In, typename Consumer >
+auto Query< Source, Stages... >::bind(Consumer consumer) const
+{
+	if constexpr (I == sizeof...(Stages))
+		return consumer;
+	else
+	{
+		using stage_type = std::tuple_element_t< I, std::tuple< Stages... > >;
+		using next_type = typename stage_type::template output< In >;
+		return std::get< I >(stages).template bind< In >(bind< I + 1, next_type >(std::move(consumer)));
+	}
+}
+template< typename Source, typename... Stages >
+template< typename F >
+void Query< Source, Stages... >::scan(const typename BucketStorage< typename Source::value_type >::bucket_view& bucket, F& f)
+{
+	bucket.for_each(std::ref(f));
+}
+template< typename Source, typename... Stages >
+template< typename F >
+void Query< Source, Stages... >::scan(std::span< const typename Source::value_type > bucket, F& f)
+{
+	for (const auto& value : bucket)
+		f(value);
+}
+
+// ------------------------------------------
+// START OF QUERY OPERATORS IMPLEMENTATION
+// ------------------------------------------
+
+template< typename Predicate >
+WhereStage< Predicate > query_where(Predicate predicate)
+{
+	return WhereStage< Predicate >(std::move(predicate));
+}
+template< typename F >
+SelectStage< F > query_select(F f)
+{
+	return SelectStage< F >(std::move(f));
+}
+inline SumSink query_sum() noexcept
+{
+	return SumSink();
+}
+inline CountSink query_count() noexcept
+{
+	return CountSink();
+}
+template< typename R, typename Op >
+ReduceSink< R, Op > query_reduce(R init, Op op)
+{
+	return ReduceSink< R, Op >(std::move(init), std::move(op));
+}
+template< QuerySource Source, QueryStage Stage >
+Query< Source, Stage > operator|(const Source& source, Stage stage)
+{
+	return Query< Source, Stage >(source, std::make_tuple(std::move(stage)));
+}
+template< QuerySource Source, QuerySink Sink >
+auto operator|(const Source& source, const Sink& sink)
+{
+	return Query< Source >(source, std::tuple<>()).run(sink);
+}
+template< typename Source, typename... Stages, QueryStage Stage >
+Query< Source, Stages..., Stage > operator|(const Query< Source, Stages... >& query, Stage stage)
+{
+	return query.then(std::move(stage));
+}
+template< typename Source, typename... Stages, QuerySink Sink >
+auto operator|(const Query< Source, Stages... >& query, const Sink& sink)
+{
+	return query.run(sink);
+}
+
+#endif /* QUERY_PIPELINE_H */
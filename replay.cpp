@@ -0,0 +1,215 @@
+#include "bucket_storage.hpp"
+#include "trace_recorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Воспроизведение трассы, записанной TraceRecorder, на разных конфигурациях хранилища.
+// Использование: bucket_storage_replay <trace> [--capacity 16,64,256] [--budget bytes]
+
+struct Options
+{
+	std::string path;
+	std::vector< size_t > capacities;
+	size_t budget = 0;
+};
+
+struct Report
+{
+	double milliseconds = 0;
+	size_t operations = 0;
+	size_t rejected = 0;
+	size_t peakCapacity = 0;
+	size_t peakBytes = 0;
+	size_t finalSize = 0;
+	size_t finalCapacity = 0;
+	double meanFragmentation = 0;
+	uint64_t checksum = 0;
+};
+
+template< size_t Size >
+struct Payload
+{
+	uint64_t id;
+	char padding[Size - sizeof(uint64_t)];
+
+	explicit Payload(uint64_t id) : id(id), padding() {}
+};
+
+template< size_t Size >
+Report replay(const std::vector< TraceRecord >& records, size_t blockCapacity, size_t budget)
+{
+	using storage_type = BucketStorage< Payload< Size > >;
+	using iterator = typename storage_type::iterator;
+
+	auto limit = budget == 0 ? std::numeric_limits< size_t >::max() : budget;
+	auto memory = std::make_shared< MemoryBudget >(limit, limit);
+	storage_type storage(blockCapacity);
+	storage.set_memory_budget(memory);
+
+	std::vector< iterator > positions;
+	std::vector< bool > alive;
+	uint64_t nextElement = 0;
+	double fragmentation = 0;
+	Report report;
+
+	auto start = std::chrono::steady_clock::now();
+	for (const TraceRecord& record : records)
+	{
+		try
+		{
+			switch (record.op)
+			{
+			case TraceOp::Insert:
+				positions.emplace_back();
+				alive.push_back(false);
+				positions.back() = storage.insert(Payload< Size >(nextElement++));
+				alive.back() = true;
+				break;
+			case TraceOp::Erase:
+				if (record.element < alive.size() && alive[record.element])
+				{
+					storage.erase(positions[record.element]);
+					alive[record.element] = false;
+				}
+				break;
+			case TraceOp::Clear:
+				storage.clear();
+				std::fill(alive.begin(), alive.end(), false);
+				break;
+			case TraceOp::ShrinkToFit:
+				storage.shrink_to_fit();
+				for (auto it = storage.begin(); it != storage.end(); ++it)
+					positions[it->id] = it;
+				break;
+			case TraceOp::Scan:
+				for (const auto& value : storage)
+					report.checksum += value.id;
+				break;
+			}
+		} catch (const budget_exceeded&)
+		{
+			++report.rejected;
+		}
+
+		if (storage.capacity() > report.peakCapacity)
+		{
+			report.peakCapacity = storage.capacity();
+			report.peakBytes = memory->usage();
+		}
+		if (storage.capacity() != 0)
+			fragmentation += 1.0 - double(storage.size()) / double(storage.capacity());
+	}
+	report.milliseconds = std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - start).count();
+
+	report.operations = records.size();
+	report.finalSize = storage.size();
+	report.finalCapacity = storage.capacity();
+	report.meanFragmentation = records.empty() ? 0 : fragmentation / double(records.size());
+	return report;
+}
+
+Report replayAny(const std::vector< TraceRecord >& records, size_t elementSize, size_t blockCapacity, size_t budget)
+{
+	if (elementSize <= 16)
+		return replay< 16 >(records, blockCapacity, budget);
+	if (elementSize <= 32)
+		return replay< 32 >(records, blockCapacity, budget);
+	if (elementSize <= 64)
+		return replay< 64 >(records, blockCapacity, budget);
+	if (elementSize <= 128)
+		return replay< 128 >(records, blockCapacity, budget);
+	return replay< 256 >(records, blockCapacity, budget);
+}
+
+std::vector< size_t > parseList(std::string_view text)
+{
+	std::vector< size_t > result;
+	while (!text.empty())
+	{
+		size_t comma = text.find(',');
+		result.push_back(std::stoul(std::string(text.substr(0, comma))));
+		text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view argument(argv[i]);
+		if (argument == "--capacity" && i + 1 < argc)
+			options.capacities = parseList(argv[++i]);
+		else if (argument == "--budget" && i + 1 < argc)
+			options.budget = std::stoul(argv[++i]);
+		else
+			options.path = argument;
+	}
+	if (options.path.empty())
+	{
+		std::fprintf(stderr, "usage: %s <trace> [--capacity 16,64,256] [--budget bytes]\n", argv[0]);
+		return 2;
+	}
+
+	std::ifstream file(options.path, std::ios::binary);
+	if (!file)
+	{
+		std::fprintf(stderr, "cannot open %s\n", options.path.c_str());
+		return 1;
+	}
+
+	try
+	{
+		TraceReader reader(file);
+		std::vector< TraceRecord > records;
+		while (auto record = reader.next())
+			records.push_back(*record);
+
+		const TraceHeader& header = reader.getHeader();
+		if (options.capacities.empty())
+			options.capacities.push_back(header.blockCapacity);
+
+		std::printf("trace: %zu records, element %llu bytes, recorded with block capacity %llu\n",
+					records.size(),
+					(unsigned long long)header.elementSize,
+					(unsigned long long)header.blockCapacity);
+		std::printf("%10s %12s %10s %14s %14s %12s %12s %10s\n",
+					"capacity",
+					"time ms",
+					"ns/op",
+					"peak slots",
+					"peak bytes",
+					"final size",
+					"final slots",
+					"mean frag");
+		for (size_t capacity : options.capacities)
+		{
+			Report report = replayAny(records, header.elementSize, capacity, options.budget);
+			std::printf("%10zu %12.3f %10.2f %14zu %14zu %12zu %12zu %10.3f\n",
+						capacity,
+						report.milliseconds,
+						report.operations == 0 ? 0.0 : report.milliseconds * 1e6 / report.operations,
+						report.peakCapacity,
+						report.peakBytes,
+						report.finalSize,
+						report.finalCapacity,
+						report.meanFragmentation);
+			if (report.rejected != 0)
+				std::printf("%10s %zu operations rejected by the memory budget\n", "", report.rejected);
+		}
+	} catch (const std::exception& error)
+	{
+		std::fprintf(stderr, "%s\n", error.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(__cpp_lib_hardware_interference_size)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+inline constexpr std::size_t DESTRUCTIVE_INTERFERENCE_SIZE = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+inline constexpr std::size_t DESTRUCTIVE_INTERFERENCE_SIZE = 64;
+#endif
+
+// ------------------------------------------
+// START OF SHARDED COUNTER INTERFACE
+// ------------------------------------------
+
+class ShardedCounter
+{
+  public:
+	using value_type = int64_t;
+	using size_type = std::size_t;
+
+	static constexpr size_type SHARDS = 16;
+
+  private:
+	struct alignas(DESTRUCTIVE_INTERFERENCE_SIZE) Shard
+	{
+		std::atomic< value_type > value{ 0 };
+	};
+
+	std::array< Shard, SHARDS > shards;
+
+  public:
+	ShardedCounter() = default;
+	ShardedCounter(const ShardedCounter& other) = delete;
+
+	ShardedCounter& operator=(const ShardedCounter& other) = delete;
+
+	void add(value_type delta) noexcept;
+	[[nodiscard]] value_type load() const noexcept;
+	void reset() noexcept;
+
+  private:
+	[[nodiscard]] static size_type shardIndex() noexcept;
+};
+
+// ------------------------------------------
+// START OF SHARDED COUNTER IMPLEMENTATION
+// ------------------------------------------
+
+inline void ShardedCounter::add(value_type delta) noexcept
+{
+	shards[shardIndex()].value.fetch_add(delta, std::memory_order_relaxed);
+}
+inline ShardedCounter::value_type ShardedCounter::load() const noexcept
+{
+	value_type result = 0;
+	for (const Shard& shard : shards)
+		result += shard.value.load(std::memory_order_relaxed);
+	return result;
+}
+inline void ShardedCounter::reset() noexcept
+{
+	for (Shard& shard : shards)
+		shard.value.store(0, std::memory_order_relaxed);
+}
+inline ShardedCounter::size_type ShardedCounter::shardIndex() noexcept
+{
+	static std::atomic< size_type > threads(0);
+	thread_local size_type index = threads.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+	return index;
+}
+
+#endif /* SHARDED_COUNTER_H */
@@ -0,0 +1,297 @@
+#ifndef SLAB_CACHE_H
+#define SLAB_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// ------------------------------------------
+// START OF SLAB CACHE INTERFACE
+// ------------------------------------------
+
+class SlabCache
+{
+  public:
+	using size_type = std::size_t;
+
+	static constexpr size_type DEFAULT_LOCAL_LIMIT = size_type(4) << 20;
+	static constexpr size_type DEFAULT_SHARED_LIMIT = size_type(16) << 20;
+	static constexpr size_type TRANSFER_BATCH = 32;
+
+  private:
+	struct Key
+	{
+		size_type size;
+		size_type align;
+		size_type count;
+
+		bool operator==(const Key& other) const = default;
+	};
+
+	struct Shelf
+	{
+		Key key;
+		std::vector< void* > slabs;
+		size_type drainedAt;
+	};
+
+	mutable std::mutex mutex;
+	std::vector< Shelf > shelves;
+	size_type limit;
+	size_type cached;
+	std::atomic< size_type > restocks;
+	size_type hitCount;
+	size_type missCount;
+	bool isShared;
+
+  public:
+	SlabCache(size_type limit, bool isShared) noexcept;
+	SlabCache(const SlabCache& other) = delete;
+	~SlabCache();
+
+	SlabCache& operator=(const SlabCache& other) = delete;
+
+	[[nodiscard]] static SlabCache& local() noexcept;
+	[[nodiscard]] static SlabCache& shared() noexcept;
+
+	[[nodiscard]] void* acquire(size_type size, size_type align, size_type count);
+	void release(void* slab, size_type size, size_type align, size_type count) noexcept;
+	[[nodiscard]] static void* acquire_uncached(size_type size, size_type align, size_type count);
+	static void release_uncached(void* slab, size_type size, size_type align, size_type count) noexcept;
+
+	void set_limit(size_type bytes) noexcept;
+	[[nodiscard]] size_type cached_bytes() const noexcept;
+	[[nodiscard]] size_type hits() const noexcept;
+	[[nodiscard]] size_type misses() const noexcept;
+	void clear() noexcept;
+
+  private:
+	[[nodiscard]] std::unique_lock< std::mutex > guard() const;
+	[[nodiscard]] Shelf* find(const Key& key) noexcept;
+	[[nodiscard]] void* take(const Key& key) noexcept;
+	[[nodiscard]] bool keep(void* slab, const Key& key) noexcept;
+	[[nodiscard]] void* refill(const Key& key);
+	void spill(void* slab, const Key& key) noexcept;
+	void trimTo(size_type bytes) noexcept;
+
+	[[nodiscard]] static size_type bytesOf(const Key& key) noexcept;
+	[[nodiscard]] static bool& localRetired() noexcept;
+	[[nodiscard]] static void* allocate(const Key& key);
+	static void deallocate(void* slab, const Key& key) noexcept;
+};
+
+// ------------------------------------------
+// START OF SLAB CACHE IMPLEMENTATION
+// ------------------------------------------
+
+inline SlabCache::SlabCache(size_type limit, bool isShared) noexcept :
+	limit(limit), cached(0), restocks(0), hitCount(0), missCount(0), isShared(isShared)
+{
+}
+inline SlabCache::~SlabCache()
+{
+	if (isShared)
+		return;
+
+	localRetired() = true;
+	SlabCache& fallback = shared();
+	auto lock = fallback.guard();
+	for (Shelf& shelf : shelves)
+		for (void* slab : shelf.slabs)
+			if (!fallback.keep(slab, shelf.key))
+				deallocate(slab, shelf.key);
+}
+inline SlabCache& SlabCache::local() noexcept
+{
+	if (localRetired())
+		return shared();
+	thread_local SlabCache cache(DEFAULT_LOCAL_LIMIT, false);
+	return cache;
+}
+inline SlabCache& SlabCache::shared() noexcept
+{
+	static SlabCache* cache = new SlabCache(DEFAULT_SHARED_LIMIT, true);
+	return *cache;
+}
+inline void* SlabCache::acquire(size_type size, size_type align, size_type count)
+{
+	Key key{ size, align, count };
+	auto lock = guard();
+	void* slab = take(key);
+	if (slab == nullptr && !isShared)
+		slab = refill(key);
+
+	if (slab != nullptr)
+	{
+		++hitCount;
+		return slab;
+	}
+	++missCount;
+	return allocate(key);
+}
+inline void SlabCache::release(void* slab, size_type size, size_type align, size_type count) noexcept
+{
+	Key key{ size, align, count };
+	auto lock = guard();
+	if (keep(slab, key))
+		return;
+	if (isShared)
+		deallocate(slab, key);
+	else
+		spill(slab, key);
+}
+inline void* SlabCache::acquire_uncached(size_type size, size_type align, size_type count)
+{
+	return allocate(Key{ size, align, count });
+}
+inline void SlabCache::release_uncached(void* slab, size_type size, size_type align, size_type count) noexcept
+{
+	deallocate(slab, Key{ size, align, count });
+}
+inline void SlabCache::set_limit(size_type bytes) noexcept
+{
+	auto lock = guard();
+	limit = bytes;
+	trimTo(limit);
+}
+inline SlabCache::size_type SlabCache::cached_bytes() const noexcept
+{
+	auto lock = guard();
+	return cached;
+}
+inline SlabCache::size_type SlabCache::hits() const noexcept
+{
+	auto lock = guard();
+	return hitCount;
+}
+inline SlabCache::size_type SlabCache::misses() const noexcept
+{
+	auto lock = guard();
+	return missCount;
+}
+inline void SlabCache::clear() noexcept
+{
+	auto lock = guard();
+	trimTo(0);
+}
+inline std::unique_lock< std::mutex > SlabCache::guard() const
+{
+	return isShared ? std::unique_lock< std::mutex >(mutex) : std::unique_lock< std::mutex >();
+}
+inline SlabCache::Shelf* SlabCache::find(const Key& key) noexcept
+{
+	for (Shelf& shelf : shelves)
+		if (shelf.key == key)
+			return &shelf;
+	return nullptr;
+}
+inline void* SlabCache::take(const Key& key) noexcept
+{
+	Shelf* shelf = find(key);
+	if (shelf == nullptr || shelf->slabs.empty())
+		return nullptr;
+
+	void* slab = shelf->slabs.back();
+	shelf->slabs.pop_back();
+	cached -= bytesOf(key);
+	return slab;
+}
+inline bool SlabCache::keep(void* slab, const Key& key) noexcept
+{
+	if (cached + bytesOf(key) > limit)
+		return false;
+
+	try
+	{
+		Shelf* shelf = find(key);
+		if (shelf == nullptr)
+			shelf = &shelves.emplace_back(Shelf{ key, {}, 0 });
+		shelf->slabs.push_back(slab);
+	} catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+	cached += bytesOf(key);
+	if (isShared)
+		restocks.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+inline void* SlabCache::refill(const Key& key)
+{
+	SlabCache& fallback = shared();
+	Shelf* shelf = find(key);
+	if (shelf == nullptr)
+		shelf = &shelves.emplace_back(Shelf{ key, {}, 0 });
+	if (shelf->drainedAt == fallback.restocks.load(std::memory_order_relaxed))
+		return nullptr;
+	shelf->slabs.reserve(shelf->slabs.size() + TRANSFER_BATCH);
+
+	auto lock = fallback.guard();
+	void* slab = fallback.take(key);
+	if (slab == nullptr)
+		shelf->drainedAt = fallback.restocks.load(std::memory_order_relaxed);
+	for (size_type i = 1; slab != nullptr && i < TRANSFER_BATCH && cached + bytesOf(key) <= limit; ++i)
+	{
+		void* extra = fallback.take(key);
+		if (extra == nullptr)
+			break;
+		shelf->slabs.push_back(extra);
+		cached += bytesOf(key);
+	}
+	return slab;
+}
+inline void SlabCache::spill(void* slab, const Key& key) noexcept
+{
+	SlabCache& fallback = shared();
+	Shelf* shelf = find(key);
+	auto lock = fallback.guard();
+	if (!fallback.keep(slab, key))
+		deallocate(slab, key);
+	for (size_type i = 1; shelf != nullptr && i < TRANSFER_BATCH && !shelf->slabs.empty(); ++i)
+	{
+		void* extra = shelf->slabs.back();
+		shelf->slabs.pop_back();
+		cached -= bytesOf(key);
+		if (!fallback.keep(extra, key))
+			deallocate(extra, key);
+	}
+}
+inline void SlabCache::trimTo(size_type bytes) noexcept
+{
+	for (Shelf& shelf : shelves)
+	{
+		while (cached > bytes && !shelf.slabs.empty())
+		{
+			deallocate(shelf.slabs.back(), shelf.key);
+			shelf.slabs.pop_back();
+			cached -= bytesOf(shelf.key);
+		}
+	}
+}
+inline SlabCache::size_type SlabCache::bytesOf(const Key& key) noexcept
+{
+	return key.size * key.count;
+}
+inline bool& SlabCache::localRetired() noexcept
+{
+	thread_local bool retired = false;
+	return retired;
+}
+inline void* SlabCache::allocate(const Key& key)
+{
+	if (key.align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		return ::operator new(bytesOf(key));
+	return ::operator new(bytesOf(key), std::align_val_t(key.align));
+}
+inline void SlabCache::deallocate(void* slab, const Key& key) noexcept
+{
+	if (key.align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		::operator delete(slab);
+	else
+		::operator delete(slab, std::align_val_t(key.align));
+}
+
+#endif /* SLAB_CACHE_H */
@@ -1,12 +1,32 @@
 #include "bucket_storage.hpp"
+#include "group_aggregate.hpp"
+#include "hash_join.hpp"
+#include "multi_bucket_storage.hpp"
+#include "query_pipeline.hpp"
+#include "sharded_counter.hpp"
+#include "slab_cache.hpp"
 #include "helpers.h"
 #include <type_traits>
 
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <future>
 #include <limits>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <utility>
+#include <variant>
 
 TEST(traits, default_constructor)
 {
@@ -270,6 +290,198 @@ TEST(base, erase)
 	ASSERT_EQ(opCount.dtorCount, n);
 }
 
+TEST(base, interleaved_insert_erase)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	std::vector< bs_sizet_t::iterator > alive;
+	size_t seed = 1;
+	for (size_t i = 0; i < 2000; ++i)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		if (alive.empty() || (seed >> 33) % 3 != 0)
+			alive.push_back(b.insert(i));
+		else
+		{
+			size_t k = (seed >> 33) % alive.size();
+			b.erase(alive[k]);
+			alive[k] = alive.back();
+			alive.pop_back();
+		}
+		ASSERT_EQ(std::distance(b.begin(), b.end()), alive.size());
+	}
+
+	bs_sizet_t copy = b;
+	copy.insert(size_t(0));
+	copy.insert(size_t(0));
+	ASSERT_EQ(std::distance(copy.begin(), copy.end()), alive.size() + 2);
+}
+
+TEST(base, erase_batch)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 320; ++i)
+		its.push_back(b.insert(i));
+
+	std::vector< bs_sizet_t::const_iterator > doomed;
+	std::vector< size_t > expected;
+	for (size_t i = 0; i < 320; ++i)
+	{
+		if (i % 3 == 0 || (i >= 32 && i < 48))
+			doomed.push_back(its[i]);
+		else
+			expected.push_back(i);
+	}
+	std::reverse(doomed.begin(), doomed.end());
+
+	ASSERT_EQ(b.erase_batch(doomed), doomed.size());
+	ASSERT_EQ(b.size(), expected.size());
+	ASSERT_EQ(b.capacity(), 19 * 16);
+	ASSERT_TRUE(std::equal(b.begin(), b.end(), expected.begin(), expected.end()));
+
+	for (size_t i = 0; i < doomed.size() - 16; ++i)
+		b.insert(size_t(1000));
+	ASSERT_EQ(b.capacity(), 19 * 16);
+	ASSERT_EQ(b.size(), b.capacity());
+	ASSERT_EQ(b.erase_batch({}), 0);
+}
+
+TEST(base, spare_buckets_and_trim)
+{
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), std::numeric_limits< size_t >::max());
+	bs_sizet_t b = bs_sizet_t(1024);
+	b.set_memory_budget(budget);
+	b.set_spare_limit(2);
+	std::vector< bs_sizet_t::const_iterator > its;
+	for (size_t i = 0; i < 4096; ++i)
+		its.push_back(b.insert(i));
+	size_t usage = budget->usage();
+
+	for (auto it : its)
+		b.erase(it);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 2048);
+	ASSERT_EQ(budget->usage(), usage / 2);
+
+	ASSERT_EQ(b.trim(std::chrono::hours(1)), 0);
+#if defined(__linux__)
+	ASSERT_GE(b.trim(), 2 * 4 * 1024 * sizeof(size_t));
+#endif
+	ASSERT_EQ(b.trim(), 0);
+
+	for (size_t i = 0; i < 2048; ++i)
+		b.insert(i);
+	ASSERT_EQ(b.capacity(), 2048);
+	ASSERT_EQ(budget->usage(), usage / 2);
+	ASSERT_EQ(std::accumulate(b.begin(), b.end(), size_t(0)), 2047 * 2048 / 2);
+	ASSERT_FALSE(b.valid(its[1024]));
+	ASSERT_TRUE(b.valid(b.begin()));
+
+	b.set_spare_limit(0);
+	b.clear();
+	ASSERT_EQ(budget->usage(), 0);
+	ASSERT_EQ(b.trim(), 0);
+	ASSERT_EQ(b.capacity(), 0);
+
+	b.reserve(3000);
+	ASSERT_EQ(b.capacity(), 3072);
+	b.set_spare_limit(1);
+	ASSERT_EQ(b.capacity(), 1024);
+	b.insert(size_t(0));
+	ASSERT_EQ(b.capacity(), 1024);
+	bs_sizet_t moved = std::move(b);
+	ASSERT_EQ(moved.capacity(), 1024);
+}
+
+TEST(base, relinked_spare_orders_last)
+{
+	for (bool stable : { false, true })
+	{
+		bs_sizet_t b = bs_sizet_t(2);
+		b.set_spare_limit(4);
+		b.set_stable_order(stable);
+		auto a = b.insert(size_t(0));
+		auto second = b.insert(size_t(1));
+		auto c = b.insert(size_t(2));
+		auto d = b.insert(size_t(3));
+		b.erase(a);
+		b.erase(second);
+		ASSERT_EQ(b.capacity(), 4);
+
+		auto e = b.insert(size_t(4));
+		ASSERT_TRUE(e > c);
+		ASSERT_TRUE(e > d);
+		ASSERT_TRUE(c < e);
+		ASSERT_EQ(*std::prev(b.end()), 4);
+		ASSERT_EQ(b.capacity(), 4);
+	}
+}
+
+TEST(base, slab_cache_reuse)
+{
+	SlabCache& cache = SlabCache::local();
+	for (size_t round = 0; round < 4; ++round)
+	{
+		bs_sizet_t b = bs_sizet_t(64);
+		for (size_t i = 0; i < 1024; ++i)
+			b.insert(i);
+	}
+	size_t misses = cache.misses();
+	size_t hits = cache.hits();
+	for (size_t round = 0; round < 16; ++round)
+	{
+		bs_sizet_t b = bs_sizet_t(64);
+		for (size_t i = 0; i < 1024; ++i)
+			b.insert(i);
+		ASSERT_EQ(std::accumulate(b.begin(), b.end(), size_t(0)), 1023 * 1024 / 2);
+	}
+	ASSERT_EQ(cache.misses(), misses);
+	ASSERT_GT(cache.hits(), hits);
+	ASSERT_GT(cache.cached_bytes(), 0);
+
+	cache.set_limit(0);
+	ASSERT_EQ(cache.cached_bytes(), 0);
+	cache.set_limit(SlabCache::DEFAULT_LOCAL_LIMIT);
+}
+
+TEST(base, slot_ring_reuse)
+{
+	std::array< size_t, 4 > order = { 0, 1, 2, 3 };
+	do
+	{
+		for (size_t erased = 1; erased <= order.size(); ++erased)
+		{
+			bs_sizet_t b = bs_sizet_t(4);
+			std::vector< bs_sizet_t::iterator > its;
+			for (size_t i = 0; i < 4; ++i)
+				its.push_back(b.insert(i));
+			for (size_t i = 0; i < erased; ++i)
+				b.erase(its[order[i]]);
+
+			bs_sizet_t copy = b;
+			for (size_t i = 0; i < erased; ++i)
+			{
+				b.insert(10 + i);
+				copy.insert(10 + i);
+			}
+
+			std::vector< size_t > expected;
+			for (size_t i = erased; i < order.size(); ++i)
+				expected.push_back(order[i]);
+			for (size_t i = 0; i < erased; ++i)
+				expected.push_back(10 + i);
+			std::sort(expected.begin(), expected.end());
+			for (const bs_sizet_t& storage : { std::cref(b), std::cref(copy) })
+			{
+				std::vector< size_t > actual(storage.begin(), storage.end());
+				std::sort(actual.begin(), actual.end());
+				ASSERT_EQ(actual, expected);
+				ASSERT_EQ(storage.capacity(), 4);
+			}
+		}
+	} while (std::next_permutation(order.begin(), order.end()));
+}
+
 TEST(base, shrink_to_fit)
 {
 	bs_sizet_t b = bs_sizet_t();
@@ -403,6 +615,17 @@ TEST(coperators, with_self)
 	ASSERT_EQ(opCount, NO_OP);
 }
 
+TEST(coperators, copy_single_element)
+{
+	bs_sizet_t b;
+	b.insert(size_t(42));
+	bs_sizet_t c = b;
+	ASSERT_EQ(c.size(), 1);
+	ASSERT_EQ(c.capacity(), 64);
+	ASSERT_EQ(*c.begin(), 42);
+	ASSERT_EQ(std::distance(c.begin(), c.end()), 1);
+}
+
 TEST(iterators, iter_const_eq)
 {
 	bs_co_t b = prepare();
@@ -444,6 +667,1578 @@ TEST(iterators, member_of_pointer)
 	}
 }
 
+TEST(content, equal_unordered)
+{
+	bs_sizet_t a = bs_sizet_t(4);
+	bs_sizet_t b = bs_sizet_t(16);
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		a.insert(i % 300);
+		b.insert((999 - i) % 300);
+	}
+	ASSERT_TRUE(equal_unordered(a, b));
+	ASSERT_EQ(a.content_hash(), b.content_hash());
+
+	b.erase(std::find(b.begin(), b.end(), 7));
+	b.insert(size_t(8));
+	ASSERT_FALSE(equal_unordered(a, b));
+	ASSERT_NE(a.content_hash(), b.content_hash());
+
+	bs_string_t c;
+	bs_string_t d;
+	for (size_t i = 0; i < 100; ++i)
+	{
+		c.insert(std::to_string(i));
+		d.insert(std::to_string(99 - i));
+	}
+	ASSERT_TRUE(equal_unordered(c, d));
+
+	d.insert(std::string("extra"));
+	ASSERT_FALSE(equal_unordered(c, d));
+	c.insert(std::string("other"));
+	ASSERT_FALSE(equal_unordered(c, d));
+}
+
+TEST(content, hash_bitwise)
+{
+	struct Point
+	{
+		int x;
+		int y;
+	};
+
+	BucketStorage< Point > a;
+	BucketStorage< Point > b;
+	for (int i = 0; i < 100; ++i)
+	{
+		a.insert(Point{ i, -i });
+		b.insert(Point{ 99 - i, i - 99 });
+	}
+	ASSERT_EQ(a.content_hash(), b.content_hash());
+	ASSERT_TRUE(equal_unordered(a, b));
+
+	b.insert(Point{ 0, 0 });
+	ASSERT_FALSE(equal_unordered(a, b));
+}
+
+TEST(content, equal_unordered_custom_equality)
+{
+	struct Letter
+	{
+		char value;
+
+		bool operator==(const Letter& other) const { return (value | 0x20) == (other.value | 0x20); }
+	};
+
+	BucketStorage< Letter > a;
+	BucketStorage< Letter > b;
+	for (char c = 'a'; c <= 'z'; ++c)
+	{
+		a.insert(Letter{ c });
+		b.insert(Letter{ char(c - 'a' + 'A') });
+	}
+	ASSERT_TRUE(equal_unordered(a, b));
+
+	b.insert(Letter{ 'Q' });
+	a.insert(Letter{ 'r' });
+	ASSERT_FALSE(equal_unordered(a, b));
+}
+
+TEST(transaction, rollback)
+{
+	bs_sizet_t b = bs_sizet_t(8);
+	for (size_t i = 0; i < 100; ++i)
+		b.insert(i);
+	const bs_sizet_t snapshot = b;
+	size_t capacity = b.capacity();
+
+	{
+		bs_sizet_t::transaction tx(b);
+		for (size_t i = 100; i < 200; ++i)
+			tx.insert(i);
+		for (size_t i = 0; i < 100; i += 3)
+			tx.erase(std::find(b.begin(), b.end(), i));
+		auto it = tx.insert(size_t(1000));
+		tx.erase(it);
+		ASSERT_TRUE(tx.active());
+		ASSERT_EQ(b.size(), 166);
+
+		tx.rollback();
+		ASSERT_FALSE(tx.active());
+	}
+	ASSERT_TRUE(equal_unordered(b, snapshot));
+	ASSERT_EQ(b.capacity(), capacity);
+
+	{
+		bs_sizet_t::transaction tx(b);
+		for (size_t i = 100; i < 200; ++i)
+			tx.insert(i);
+	}
+	ASSERT_TRUE(equal_unordered(b, snapshot));
+}
+
+TEST(transaction, rollback_over_budget)
+{
+	bs_sizet_t b = bs_sizet_t(8);
+	for (size_t i = 0; i < 64; ++i)
+		b.insert(i);
+	const bs_sizet_t snapshot = b;
+	auto probe = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), std::numeric_limits< size_t >::max());
+	b.set_memory_budget(probe);
+	auto budget = std::make_shared< MemoryBudget >(probe->usage(), probe->usage());
+	b.set_memory_budget(budget);
+
+	bs_sizet_t other = bs_sizet_t(8);
+	other.set_memory_budget(budget);
+	bs_sizet_t::transaction tx(b);
+	for (size_t i = 0; i < 16; ++i)
+		tx.erase(std::find(b.begin(), b.end(), i));
+	for (size_t i = 0; i < 16; ++i)
+		other.insert(i);
+	ASSERT_THROW(other.insert(size_t(16)), budget_exceeded);
+
+	tx.rollback();
+	ASSERT_FALSE(tx.active());
+	ASSERT_TRUE(equal_unordered(b, snapshot));
+	ASSERT_GT(budget->usage(), budget->capacity());
+	ASSERT_THROW(other.insert(size_t(16)), budget_exceeded);
+}
+
+TEST(transaction, commit)
+{
+	bs_co_t b = prepare();
+	size_t n = b.size();
+	{
+		bs_co_t::transaction tx(b);
+		tx.insert(CountedOperationObject(n));
+		tx.erase(b.begin());
+		tx.commit();
+	}
+	ASSERT_EQ(b.size(), n);
+	ASSERT_EQ(std::count(b.begin(), b.end(), CountedOperationObject(n)), 1);
+}
+
+TEST(drain, consume)
+{
+	bs_co_t b = prepare();
+	size_t n = b.size();
+	size_t sum = 0;
+	b.drain([&sum](CountedOperationObject &&value) { sum += value.number; });
+
+	ASSERT_EQ(opCount, OpCount(0, 0, 0, 0, 0, n));
+	ASSERT_EQ(sum, n * (n - 1) / 2);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 0);
+	ASSERT_EQ(b.begin(), b.end());
+
+	b.insert(CountedOperationObject(1));
+	ASSERT_EQ(b.size(), 1);
+}
+
+TEST(drain, consumer_throws)
+{
+	bs_sizet_t b = bs_sizet_t(8);
+	for (size_t i = 0; i < 100; ++i)
+		b.insert(i);
+
+	size_t consumed = 0;
+	try
+	{
+		b.drain(
+			[&consumed](size_t &&)
+			{
+				if (consumed == 21)
+					throw -1;
+				++consumed;
+			});
+	} catch (int)
+	{
+	}
+	ASSERT_EQ(b.size(), 100 - consumed);
+	ASSERT_EQ(std::distance(b.begin(), b.end()), 100 - consumed);
+
+	for (size_t i = 0; i < 10; ++i)
+		b.insert(i);
+	ASSERT_EQ(b.size(), 110 - consumed);
+	ASSERT_EQ(std::distance(b.begin(), b.end()), 110 - consumed);
+}
+
+TEST(drain, drain_into)
+{
+	bs_co_t b = prepare();
+	size_t n = b.size();
+	bs_co_t c;
+	c.insert(CountedOperationObject(n));
+	opCount.clearCounters();
+
+	b.drain_into(c);
+	ASSERT_EQ(opCount, NO_OP);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 0);
+	ASSERT_EQ(c.size(), n + 1);
+	ASSERT_EQ(std::distance(c.begin(), c.end()), n + 1);
+
+	for (auto it = c.begin(); it != c.end(); ++it)
+		ASSERT_TRUE(it < c.end());
+
+	bs_co_t d = bs_co_t(10);
+	opCount.clearCounters();
+	c.drain_into(d);
+	ASSERT_EQ(opCount, OpCount(0, 0, 1, 0, 0, 1));
+	ASSERT_EQ(d.size(), n + 1);
+	ASSERT_EQ(d.capacity(), (n + 64) & -64);
+
+	b.insert(CountedOperationObject(0));
+	ASSERT_EQ(b.size(), 1);
+}
+
+TEST(drain, moved_storage_insert)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	for (size_t i = 0; i < 10; ++i)
+		b.insert(i);
+	b.erase(b.begin());
+	b.shrink_to_fit();
+
+	for (size_t i = 0; i < 10; ++i)
+		b.insert(i);
+	ASSERT_EQ(b.size(), 19);
+	ASSERT_EQ(b.capacity(), 20);
+}
+
+TEST(merge, different_capacities)
+{
+	bs_co_t a = bs_co_t(16);
+	bs_co_t b = bs_co_t(10);
+	for (size_t i = 0; i < 100; ++i)
+		a.insert(CountedOperationObject(i));
+	for (size_t i = 100; i < 200; ++i)
+		b.insert(CountedOperationObject(i));
+	for (size_t i = 100; i < 109; ++i)
+		b.erase(std::find(b.begin(), b.end(), CountedOperationObject(i)));
+	opCount.clearCounters();
+
+	size_t moves = a.merge(b);
+	ASSERT_EQ(moves, 1);
+	ASSERT_EQ(opCount, OpCount(0, 0, moves, 0, 0, moves));
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 0);
+	ASSERT_EQ(a.size(), 191);
+	ASSERT_EQ(a.capacity(), 7 * 16 + 9 * 10);
+
+	size_t sum = 0;
+	for (auto &value : a)
+		sum += value.number;
+	ASSERT_EQ(sum, 199 * 200 / 2 - (100 + 108) * 9 / 2);
+
+	for (size_t i = 0; i < 20; ++i)
+		a.insert(CountedOperationObject(i));
+	ASSERT_EQ(a.size(), 211);
+	ASSERT_EQ(a.capacity(), 8 * 16 + 9 * 10);
+
+	for (auto it = a.begin(); it != a.end(); ++it)
+		ASSERT_TRUE(it < a.end());
+	while (!a.empty())
+		a.erase(a.begin());
+	ASSERT_EQ(a.capacity(), 0);
+}
+
+TEST(budget, fail_and_trim)
+{
+	size_t bucket = 4 * 64 * sizeof(size_t);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket += 64 * sizeof(bs_sizet_t::generation_type);
+#endif
+	auto budget = std::make_shared< MemoryBudget >(3 * bucket + 1024, 2 * bucket + 1024);
+	size_t trims = 0;
+	budget->add_trim_hook([&trims] { ++trims; });
+
+	bs_sizet_t b;
+	b.set_memory_budget(budget);
+	for (size_t i = 0; i < 192; ++i)
+		b.insert(i);
+	ASSERT_EQ(trims, 1);
+	ASSERT_GT(budget->usage(), 3 * bucket);
+
+	ASSERT_THROW(b.insert(size_t(192)), budget_exceeded);
+	ASSERT_EQ(b.size(), 192);
+	ASSERT_EQ(b.capacity(), 192);
+	ASSERT_EQ(trims, 3);
+
+	for (size_t i = 0; i < 64; ++i)
+		b.erase(std::find(b.begin(), b.end(), i));
+	b.insert(size_t(192));
+	ASSERT_EQ(b.size(), 129);
+
+	size_t usage = budget->usage();
+	ASSERT_THROW(bs_sizet_t c = b, budget_exceeded);
+	ASSERT_EQ(budget->usage(), usage);
+
+	b.clear();
+	ASSERT_EQ(budget->usage(), 0);
+
+	b.insert(size_t(1));
+	b.shrink_to_fit();
+	ASSERT_EQ(b.memory_budget(), budget);
+	bs_sizet_t c = b;
+	ASSERT_EQ(c.memory_budget(), budget);
+	ASSERT_GT(budget->usage(), 2 * 64 * 4 * sizeof(size_t));
+	c.clear();
+	b.clear();
+	ASSERT_EQ(budget->usage(), 0);
+}
+
+TEST(budget, block_until_released)
+{
+	size_t bucket = 4 * 64 * sizeof(size_t);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket += 64 * sizeof(bs_sizet_t::generation_type);
+#endif
+	auto budget = std::make_shared< MemoryBudget >(bucket + 1024, bucket + 1024, MemoryBudget::Policy::Block);
+
+	bs_sizet_t a;
+	bs_sizet_t b;
+	a.set_memory_budget(budget);
+	b.set_memory_budget(budget);
+	a.insert(size_t(1));
+
+	std::thread inserter([&b] { b.insert(size_t(2)); });
+	while (budget->usage() == 0)
+		std::this_thread::yield();
+	a.clear();
+	inserter.join();
+
+	ASSERT_EQ(b.size(), 1);
+	ASSERT_TRUE(a.empty());
+}
+
+TEST(budget, hooks_run_after_operation)
+{
+	size_t bucket = 4 * 8 * sizeof(size_t);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket += 8 * sizeof(bs_sizet_t::generation_type);
+#endif
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), 2 * bucket);
+	bs_sizet_t b = bs_sizet_t(8);
+	b.set_memory_budget(budget);
+	size_t trims = 0;
+	budget->add_trim_hook(
+		[&b, &trims]
+		{
+			++trims;
+			b.shrink_to_fit();
+		});
+
+	for (size_t i = 0; i < 64; ++i)
+	{
+		b.insert(i);
+		if (i % 3 == 0)
+			b.erase(std::find(b.begin(), b.end(), i));
+	}
+	ASSERT_GT(trims, 0);
+	ASSERT_EQ(b.size(), 42);
+	ASSERT_EQ(std::distance(b.begin(), b.end()), 42);
+	size_t sum = 0;
+	for (size_t i = 0; i < 64; ++i)
+		if (i % 3 != 0)
+			sum += i;
+	ASSERT_EQ(std::accumulate(b.begin(), b.end(), size_t(0)), sum);
+}
+
+TEST(budget, block_times_out)
+{
+	size_t bucket = 4 * 64 * sizeof(size_t);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket += 64 * sizeof(bs_sizet_t::generation_type);
+#endif
+	auto budget = std::make_shared< MemoryBudget >(bucket + 1024, bucket + 1024, MemoryBudget::Policy::Block);
+	budget->set_block_timeout(std::chrono::milliseconds(10));
+
+	bs_sizet_t a;
+	bs_sizet_t b;
+	a.set_memory_budget(budget);
+	b.set_memory_budget(budget);
+	a.insert(size_t(1));
+	size_t usage = budget->usage();
+	ASSERT_THROW(b.insert(size_t(2)), budget_exceeded);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(budget->usage(), usage);
+}
+
+TEST(budget, hooks_make_room_before_failing)
+{
+	size_t bucket = 4 * 64 * sizeof(size_t);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket += 64 * sizeof(bs_sizet_t::generation_type);
+#endif
+	for (MemoryBudget::Policy policy : { MemoryBudget::Policy::Fail, MemoryBudget::Policy::Block })
+	{
+		auto budget = std::make_shared< MemoryBudget >(bucket + 1024, bucket + 1024, policy);
+		bs_sizet_t a;
+		bs_sizet_t b;
+		a.set_memory_budget(budget);
+		b.set_memory_budget(budget);
+		budget->add_trim_hook([&a] { a.clear(); });
+		a.insert(size_t(1));
+
+		auto start = std::chrono::steady_clock::now();
+		b.insert(size_t(2));
+		ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+		ASSERT_TRUE(a.empty());
+		ASSERT_EQ(b.size(), 1);
+
+		b.clear();
+		a.insert(size_t(1));
+		b.reserve(64);
+		ASSERT_TRUE(a.empty());
+		ASSERT_EQ(b.capacity(), 64);
+	}
+}
+
+TEST(budget, other_threads_do_not_defer_trims)
+{
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), 0);
+	size_t trims = 0;
+	budget->add_trim_hook([&trims] { ++trims; });
+
+	std::atomic< bool > opened = false;
+	std::atomic< bool > done = false;
+	std::thread worker(
+		[&]
+		{
+			MemoryBudget::operation_scope scope(budget.get());
+			opened = true;
+			while (!done)
+				std::this_thread::yield();
+		});
+	while (!opened)
+		std::this_thread::yield();
+
+	bs_sizet_t b;
+	b.set_memory_budget(budget);
+	b.insert(size_t(1));
+	size_t during = trims;
+	done = true;
+	worker.join();
+	ASSERT_EQ(during, 1);
+	ASSERT_EQ(trims, 1);
+}
+
+struct BudgetTask
+{
+	struct promise_type
+	{
+		BudgetTask get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+BudgetTask insertWhenAvailable(MemoryBudget &budget, bs_sizet_t &storage, size_t bytes, bool &done)
+{
+	co_await budget.available(bytes);
+	storage.insert(size_t(1));
+	done = true;
+}
+
+TEST(budget, await_available)
+{
+	size_t bucket = 4 * 64 * sizeof(size_t);
+#ifdef BUCKET_STORAGE_GENERATIONS
+	bucket += 64 * sizeof(bs_sizet_t::generation_type);
+#endif
+	auto budget = std::make_shared< MemoryBudget >(bucket + 1024, bucket + 1024, MemoryBudget::Policy::Await);
+
+	bs_sizet_t a;
+	bs_sizet_t b;
+	a.set_memory_budget(budget);
+	b.set_memory_budget(budget);
+	a.insert(size_t(1));
+	ASSERT_THROW(b.insert(size_t(1)), budget_exceeded);
+
+	bool done = false;
+	insertWhenAvailable(*budget, b, bucket, done);
+	ASSERT_FALSE(done);
+	ASSERT_EQ(budget->run_ready(), 0);
+
+	a.clear();
+	ASSERT_FALSE(done);
+	ASSERT_EQ(budget->run_ready(), 1);
+	ASSERT_TRUE(done);
+	ASSERT_EQ(b.size(), 1);
+}
+
+struct HeldBudgetTask
+{
+	struct promise_type
+	{
+		HeldBudgetTask get_return_object() { return { std::coroutine_handle< promise_type >::from_promise(*this) }; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	std::coroutine_handle< promise_type > handle;
+};
+
+HeldBudgetTask awaitBudget(MemoryBudget &budget, size_t bytes)
+{
+	co_await budget.available(bytes);
+}
+
+TEST(budget, destroyed_awaiters_leave_queue)
+{
+	MemoryBudget budget(1024, 1024, MemoryBudget::Policy::Await);
+	budget.force_charge(1024);
+
+	HeldBudgetTask queued = awaitBudget(budget, 512);
+	HeldBudgetTask woken = awaitBudget(budget, 512);
+	ASSERT_FALSE(queued.handle.done());
+	queued.handle.destroy();
+	budget.release(512);
+	woken.handle.destroy();
+	ASSERT_EQ(budget.run_ready(), 0);
+
+	HeldBudgetTask resumed = awaitBudget(budget, 1024);
+	budget.release(512);
+	ASSERT_EQ(budget.run_ready(), 1);
+	ASSERT_TRUE(resumed.handle.done());
+	resumed.handle.destroy();
+}
+
+TEST(latency, histogram_buckets)
+{
+	for (uint64_t value : { 0ULL, 1ULL, 31ULL, 32ULL, 33ULL, 1000ULL, 123456789ULL, ~0ULL })
+	{
+		size_t index = LatencyHistogram::indexOf(value);
+		ASSERT_LT(index, LatencyHistogram::BUCKETS);
+		ASSERT_GE(LatencyHistogram::upperBound(index), value);
+		if (index > 0)
+		{
+			ASSERT_LT(LatencyHistogram::upperBound(index - 1), value);
+		}
+	}
+}
+
+TEST(latency, insert_phases)
+{
+	LatencyRegistry &registry = LatencyRegistry::instance();
+	registry.reset();
+
+	bs_sizet_t b = bs_sizet_t(8);
+	for (size_t i = 0; i < 100; ++i)
+		b.insert(i);
+	b.erase(b.begin());
+	std::thread([&b] { b.insert(size_t(0)); }).join();
+
+	ASSERT_EQ(registry.snapshot(LatencyEvent::Insert).count, 101);
+	ASSERT_EQ(registry.snapshot(LatencyEvent::Allocation).count, 101);
+	ASSERT_EQ(registry.snapshot(LatencyEvent::Construction).count, 101);
+	ASSERT_EQ(registry.snapshot(LatencyEvent::Erase).count, 1);
+
+	LatencySnapshot insert = registry.snapshot(LatencyEvent::Insert);
+	ASSERT_LE(insert.percentile(0.5), insert.percentile(0.99));
+	ASSERT_LE(insert.percentile(0.99), insert.max);
+
+	std::ostringstream os;
+	registry.write(os);
+	ASSERT_NE(os.str().find("insert"), std::string::npos);
+}
+
+TEST(latency, recycle_thread_slots)
+{
+	LatencyRegistry &registry = LatencyRegistry::instance();
+	std::thread([] { LatencyRegistry::record(LatencyEvent::BucketScan, 1); }).join();
+	registry.reset();
+	size_t slots = registry.slots();
+
+	for (size_t i = 0; i < 32; ++i)
+		std::thread([] { LatencyRegistry::record(LatencyEvent::BucketScan, 1); }).join();
+	ASSERT_EQ(registry.slots(), slots);
+	ASSERT_EQ(registry.snapshot(LatencyEvent::BucketScan).count, 32);
+}
+
+TEST(latency, reset_while_recording)
+{
+	LatencyRegistry &registry = LatencyRegistry::instance();
+	std::atomic< bool > started = false;
+	std::atomic< bool > done = false;
+	std::thread worker(
+		[&started, &done]
+		{
+			while (!done)
+			{
+				LatencyRegistry::record(LatencyEvent::BucketScan, 1);
+				started = true;
+			}
+		});
+	while (!started)
+		std::this_thread::yield();
+	auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+	while (std::chrono::steady_clock::now() < until)
+		registry.reset();
+	done = true;
+	worker.join();
+
+	LatencySnapshot scans = registry.snapshot(LatencyEvent::BucketScan);
+	ASSERT_EQ(std::accumulate(scans.counts.begin(), scans.counts.end(), uint64_t(0)), scans.count);
+	ASSERT_EQ(scans.sum, scans.count);
+
+	registry.reset();
+	ASSERT_EQ(registry.snapshot(LatencyEvent::BucketScan).count, 0);
+	LatencyRegistry::record(LatencyEvent::BucketScan, 1);
+	ASSERT_EQ(registry.snapshot(LatencyEvent::BucketScan).count, 1);
+}
+
+TEST(trace, record_and_read)
+{
+	std::stringstream trace;
+	TraceRecorder recorder(trace);
+
+	bs_sizet_t b = bs_sizet_t(4);
+	b.insert(size_t(100));
+	b.set_trace_recorder(&recorder);
+	for (size_t i = 0; i < 10; ++i)
+		b.insert(i);
+	b.erase(b.begin());
+	b.erase(b.begin());
+	b.shrink_to_fit();
+	b.erase(b.begin());
+	(void)b.content_hash();
+	ASSERT_EQ(recorder.size(), b.size());
+	b.clear();
+
+	TraceReader reader(trace);
+	ASSERT_EQ(reader.getHeader().elementSize, sizeof(size_t));
+	ASSERT_EQ(reader.getHeader().blockCapacity, 4);
+
+	std::vector< TraceOp > ops;
+	std::vector< uint64_t > erased;
+	while (auto record = reader.next())
+	{
+		ops.push_back(record->op);
+		if (record->op == TraceOp::Erase)
+			erased.push_back(record->element);
+	}
+	ASSERT_EQ(ops.size(), 11 + 3 + 3);
+	ASSERT_EQ(std::count(ops.begin(), ops.end(), TraceOp::Insert), 11);
+	ASSERT_EQ(ops[13], TraceOp::ShrinkToFit);
+	ASSERT_EQ(ops[15], TraceOp::Scan);
+	ASSERT_EQ(ops.back(), TraceOp::Clear);
+	ASSERT_EQ(erased.size(), 3);
+	ASSERT_EQ(erased[0], 0);
+	ASSERT_EQ(erased[2], 2);
+}
+
+struct ThrowingCopy
+{
+	static inline std::atomic< int > copiesLeft = 0;
+
+	size_t value;
+
+	explicit ThrowingCopy(size_t value) noexcept : value(value) {}
+	ThrowingCopy(ThrowingCopy &&other) noexcept = default;
+	ThrowingCopy(const ThrowingCopy &other) : value(other.value)
+	{
+		if (--copiesLeft < 0)
+			throw std::runtime_error("copy failed");
+	}
+};
+
+TEST(parallel, copy_preserves_order)
+{
+	bs_sizet_t b = bs_sizet_t(2);
+	b.set_parallelism(4);
+	for (size_t i = 0; i < 600; ++i)
+		b.insert(i);
+	for (auto it = b.begin(); it != b.end();)
+	{
+		it = b.erase(it);
+		if (it != b.end())
+			++it;
+		if (it != b.end())
+			++it;
+	}
+
+	bs_sizet_t c = b;
+	ASSERT_TRUE(std::equal(b.begin(), b.end(), c.begin(), c.end()));
+	ASSERT_EQ(c.capacity(), b.capacity());
+
+	size_t holes = c.capacity() - c.size();
+	for (size_t i = 0; i < holes; ++i)
+		c.insert(i);
+	ASSERT_EQ(c.capacity(), b.capacity());
+}
+
+TEST(parallel, copy_strong_guarantee)
+{
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), std::numeric_limits< size_t >::max());
+	BucketStorage< ThrowingCopy > b(2);
+	b.set_parallelism(4);
+	b.set_memory_budget(budget);
+	for (size_t i = 0; i < 600; ++i)
+		b.insert(ThrowingCopy(i));
+	size_t usage = budget->usage();
+
+	ThrowingCopy::copiesLeft = 450;
+	ASSERT_THROW(BucketStorage< ThrowingCopy > c(b), std::runtime_error);
+	ASSERT_EQ(budget->usage(), usage);
+	ASSERT_EQ(b.size(), 600);
+}
+
+TEST(parallel, clear_and_detach_destroy)
+{
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), std::numeric_limits< size_t >::max());
+	bs_string_t b = bs_string_t(1);
+	b.set_parallelism(4);
+	b.set_memory_budget(budget);
+	for (size_t i = 0; i < 300; ++i)
+		b.insert(std::to_string(i));
+	b.clear();
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(budget->usage(), 0);
+
+	for (size_t i = 0; i < 300; ++i)
+		b.insert(std::to_string(i));
+	std::future< void > destroyed = b.detach_destroy();
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.memory_budget(), budget);
+
+	b.insert(std::string("alive"));
+	destroyed.get();
+	ASSERT_EQ(budget->usage(), bs_string_t::bytes_for(1, 1) - bs_string_t::bytes_for(0, 1));
+	ASSERT_EQ(*b.begin(), "alive");
+}
+
+struct ThreadBound
+{
+	static inline std::thread::id owner;
+	static inline std::atomic< size_t > foreign = 0;
+
+	size_t value;
+
+	explicit ThreadBound(size_t value) noexcept : value(value) {}
+	ThreadBound(const ThreadBound &other) noexcept : value(other.value) { check(); }
+	~ThreadBound() { check(); }
+
+	static void check() noexcept
+	{
+		if (std::this_thread::get_id() != owner)
+			++foreign;
+	}
+};
+
+TEST(parallel, opt_in)
+{
+	ThreadBound::owner = std::this_thread::get_id();
+	ThreadBound::foreign = 0;
+	{
+		BucketStorage< ThreadBound > b(1);
+		ASSERT_EQ(b.parallelism(), 1);
+		for (size_t i = 0; i < 4096; ++i)
+			b.insert(ThreadBound(i));
+		BucketStorage< ThreadBound > c = b;
+		c.clear();
+	}
+	ASSERT_EQ(ThreadBound::foreign, 0);
+
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), std::numeric_limits< size_t >::max());
+	bs_sizet_t b = bs_sizet_t(1);
+	b.set_memory_budget(budget);
+	for (size_t i = 0; i < 256; ++i)
+		b.insert(i);
+	{
+		std::future< void > destroyed = b.detach_destroy();
+	}
+	ASSERT_EQ(budget->usage(), 0);
+}
+
+TEST(parallel, reserve_with_thread_affinity)
+{
+	auto budget = std::make_shared< MemoryBudget >(std::numeric_limits< size_t >::max(), std::numeric_limits< size_t >::max());
+	bs_sizet_t b = bs_sizet_t(2);
+	b.set_parallelism(4);
+	b.set_thread_affinity(true);
+	b.set_memory_budget(budget);
+	b.reserve(600);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 600);
+	size_t usage = budget->usage();
+	ASSERT_GT(usage, 0);
+
+	for (size_t i = 0; i < 600; ++i)
+		b.insert(i);
+	ASSERT_EQ(b.capacity(), 600);
+	ASSERT_EQ(budget->usage(), usage);
+	size_t expected = 0;
+	for (size_t value : b)
+		ASSERT_EQ(value, expected++);
+
+	std::vector< size_t > owners;
+	for (const auto& bucket : b.buckets())
+		owners.push_back(bucket.owner());
+	ASSERT_TRUE(std::is_sorted(owners.begin(), owners.end()));
+	ASSERT_EQ(owners.front(), 0);
+	ASSERT_EQ(owners.back(), 3);
+
+	size_t sum = b.fold_buckets(
+		[] { return size_t(0); },
+		[](size_t& result, const auto& bucket) { bucket.for_each([&result](size_t value) { result += value; }); },
+		[](size_t first, size_t second) { return first + second; });
+	ASSERT_EQ(sum, 599 * 600 / 2);
+
+	{
+		bs_sizet_t c = b;
+		std::vector< size_t > copied;
+		for (const auto& bucket : c.buckets())
+			copied.push_back(bucket.owner());
+		ASSERT_EQ(copied, owners);
+		ASSERT_TRUE(std::equal(b.begin(), b.end(), c.begin(), c.end()));
+	}
+
+	b.insert(size_t(600));
+	b.clear();
+	b.reserve(10);
+	ASSERT_EQ(b.capacity(), 10);
+	b.set_memory_budget(nullptr);
+	ASSERT_EQ(budget->usage(), 0);
+	b.shrink_to_fit();
+	ASSERT_EQ(b.capacity(), 0);
+	ASSERT_TRUE(b.thread_affinity());
+}
+
+TEST(parallel, affinity_reserve_bypasses_slab_cache)
+{
+	SlabCache& cache = SlabCache::local();
+	auto consumed = [&cache](bool affinity)
+	{
+		size_t before = cache.cached_bytes();
+		bs_sizet_t b = bs_sizet_t(64);
+		b.set_thread_affinity(affinity);
+		b.reserve(64 * 16);
+		for (size_t i = 0; i < 64 * 16; ++i)
+			b.insert(i);
+		return before - cache.cached_bytes();
+	};
+	consumed(false);
+	size_t cachedSlabs = consumed(false);
+	size_t placedSlabs = consumed(true);
+	ASSERT_GE(cachedSlabs - placedSlabs, 16 * 64 * (sizeof(size_t) + 2 * sizeof(bs_sizet_t::size_type) + sizeof(bs_sizet_t::id_type)));
+}
+
+TEST(parallel, padded_layout_and_sharded_counter)
+{
+	ShardedCounter counter;
+	std::vector< std::thread > workers;
+	for (int t = 0; t < 8; ++t)
+		workers.emplace_back(
+			[&counter]
+			{
+				for (int i = 0; i < 1000; ++i)
+					counter.add(i % 2 == 0 ? 3 : -1);
+			});
+	for (auto& worker : workers)
+		worker.join();
+	ASSERT_EQ(counter.load(), 8 * 500 * 2);
+	counter.reset();
+	ASSERT_EQ(counter.load(), 0);
+
+#ifdef BUCKET_STORAGE_PADDED_LAYOUT
+	static_assert(alignof(bs_sizet_t) >= DESTRUCTIVE_INTERFERENCE_SIZE);
+	static_assert(sizeof(bs_sizet_t) >= 2 * DESTRUCTIVE_INTERFERENCE_SIZE);
+#endif
+	std::vector< bs_sizet_t > storages(3, bs_sizet_t(4));
+	for (auto& storage : storages)
+		for (size_t i = 0; i < 10; ++i)
+			storage.insert(i);
+	storages.emplace_back(storages.front());
+	for (const auto& storage : storages)
+		ASSERT_EQ(std::accumulate(storage.begin(), storage.end(), size_t(0)), 45);
+}
+
+TEST(coroutines, generators)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	for (size_t i = 0; i < 10; ++i)
+		b.insert(i);
+
+	size_t expected = 0;
+	for (const size_t &value : b.elements())
+		ASSERT_EQ(value, expected++);
+	ASSERT_EQ(expected, 10);
+
+	size_t elements = 0;
+	size_t buckets = 0;
+	for (auto bucket : b.buckets())
+	{
+		++buckets;
+		elements += std::distance(bucket.begin(), bucket.end());
+		ASSERT_EQ(bucket.capacity(), 4);
+	}
+	ASSERT_EQ(buckets, 3);
+	ASSERT_EQ(elements, 10);
+}
+
+TEST(coroutines, compact_in_steps)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 400; ++i)
+		its.push_back(b.insert(i));
+	for (size_t i = 0; i < its.size(); ++i)
+		if (i % 4 != 0)
+			b.erase(its[i]);
+	ASSERT_EQ(b.capacity(), 400);
+
+	MaintenanceTask task = b.co_compact(5);
+	size_t steps = 0;
+	while (task.resume())
+	{
+		++steps;
+		b.insert(size_t(1000));
+	}
+	ASSERT_GE(steps, 2);
+	ASSERT_EQ(b.size(), 100 + steps);
+	ASSERT_LT(b.capacity() - b.size(), 4);
+
+	std::vector< size_t > values(b.begin(), b.end());
+	std::sort(values.begin(), values.end());
+	for (size_t i = 0; i < 100; ++i)
+		ASSERT_EQ(values[i], i * 4);
+
+	bs_sizet_t stable = bs_sizet_t(4);
+	stable.set_stable_order(true);
+	its.clear();
+	for (size_t i = 0; i < 9; ++i)
+		its.push_back(stable.insert(i));
+	stable.erase(its[0]);
+
+	MaintenanceTask compacting = stable.co_compact(10);
+	compacting.run();
+	ASSERT_TRUE(compacting.done());
+	ASSERT_EQ(stable.size(), 8);
+	ASSERT_EQ(stable.capacity(), 8);
+	values.assign(stable.begin(), stable.end());
+	std::sort(values.begin(), values.end());
+	for (size_t i = 0; i < 8; ++i)
+		ASSERT_EQ(values[i], i + 1);
+}
+
+TEST(coroutines, clear_and_copy_in_steps)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	for (size_t i = 0; i < 103; ++i)
+		b.insert(i);
+
+	bs_sizet_t copy = bs_sizet_t(4);
+	MaintenanceTask copying = b.co_copy(copy, 10);
+	ASSERT_TRUE(copying.resume());
+	ASSERT_EQ(copying.progress(), 10);
+	ASSERT_EQ(copy.size(), 40);
+	copying.run();
+	ASSERT_TRUE(copying.done());
+	ASSERT_TRUE(std::equal(b.begin(), b.end(), copy.begin(), copy.end()));
+
+	auto tail = std::prev(copy.end());
+	auto fresh = copy.insert(size_t(1000));
+	ASSERT_TRUE(fresh > tail);
+	ASSERT_FALSE(fresh < tail);
+	ASSERT_EQ(*std::prev(copy.end()), 1000);
+
+	MaintenanceTask clearing = b.co_clear(10);
+	size_t steps = 0;
+	while (clearing.resume())
+		++steps;
+	ASSERT_EQ(steps, 3);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 0);
+	ASSERT_EQ(copy.size(), 104);
+}
+
+TEST(coroutines, copy_survives_source_mutation)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 12; ++i)
+		its.push_back(b.insert(i));
+
+	bs_sizet_t copy = bs_sizet_t(4);
+	MaintenanceTask copying = b.co_copy(copy, 1);
+	ASSERT_TRUE(copying.resume());
+	for (size_t i = 4; i < 8; ++i)
+		b.erase(its[i]);
+	copying.run();
+	ASSERT_TRUE(copying.done());
+	ASSERT_EQ(copy.size(), 8);
+	ASSERT_TRUE(std::equal(b.begin(), b.end(), copy.begin(), copy.end()));
+}
+
+TEST(memory, bytes_for_estimate)
+{
+	static_assert(bs_sizet_t::bytes_for(0) < bs_sizet_t::bytes_for(1));
+	static_assert(bs_sizet_t::bytes_for(16, 16) == bs_sizet_t::bytes_for(1, 16));
+	static_assert(bs_sizet_t::bytes_for(17, 16) > bs_sizet_t::bytes_for(16, 16));
+
+	bs_sizet_t b = bs_sizet_t(16);
+	ASSERT_GE(b.memory_usage(), bs_sizet_t::bytes_for(0, 16));
+	for (size_t i = 0; i < 1000; ++i)
+		b.insert(i);
+
+	size_t estimate = bs_sizet_t::bytes_for(b.size(), 16);
+	ASSERT_GE(b.memory_usage(), estimate);
+	ASSERT_LE(b.memory_usage(), estimate + estimate / 4);
+}
+
+template< typename F >
+OperationCounters countOperations(F f)
+{
+	OperationCounters before = OperationCounters::local();
+	f();
+	return OperationCounters::local() - before;
+}
+
+TEST(complexity, insert_constant)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	b.set_parallelism(1);
+	OperationCounters worst;
+	OperationCounters total;
+	for (size_t i = 0; i < 10000; ++i)
+	{
+		OperationCounters delta = countOperations([&] { b.insert(i); });
+		worst.bucketTraversals = std::max(worst.bucketTraversals, delta.bucketTraversals);
+		worst.slotTraversals = std::max(worst.slotTraversals, delta.slotTraversals);
+		worst.metadataWrites = std::max(worst.metadataWrites, delta.metadataWrites);
+		total.allocations += delta.allocations;
+	}
+
+	ASSERT_LE(worst.traversals(), 4);
+	ASSERT_LE(worst.metadataWrites, 8);
+	ASSERT_EQ(total.allocations, b.capacity() / 16);
+}
+
+TEST(complexity, erase_constant)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	b.set_parallelism(1);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 10000; ++i)
+		its.push_back(b.insert(i));
+
+	OperationCounters worst;
+	OperationCounters total;
+	for (size_t i = 0; i < its.size(); ++i)
+	{
+		OperationCounters delta = countOperations([&] { b.erase(its[i * 7919 % its.size()]); });
+		worst.bucketTraversals = std::max(worst.bucketTraversals, delta.bucketTraversals);
+		worst.slotTraversals = std::max(worst.slotTraversals, delta.slotTraversals);
+		worst.metadataWrites = std::max(worst.metadataWrites, delta.metadataWrites);
+		total.deallocations += delta.deallocations;
+	}
+
+	ASSERT_TRUE(b.empty());
+	ASSERT_LE(worst.traversals(), 8);
+	ASSERT_LE(worst.metadataWrites, 12);
+	ASSERT_EQ(total.deallocations, 10000 / 16);
+}
+
+TEST(complexity, get_to_distance_skips_buckets)
+{
+	const size_t capacity = 16;
+	bs_sizet_t b = bs_sizet_t(capacity);
+	b.set_parallelism(1);
+	for (size_t i = 0; i < 10000; ++i)
+		b.insert(i);
+	const size_t buckets = b.capacity() / capacity;
+
+	for (ptrdiff_t distance : { 1, 15, 16, 17, 5000, 9999 })
+	{
+		bs_sizet_t::iterator it;
+		OperationCounters forward = countOperations([&] { it = b.get_to_distance(b.begin(), distance); });
+		ASSERT_EQ(*it, size_t(distance));
+		ASSERT_LE(forward.traversals(), buckets + capacity);
+
+		OperationCounters backward = countOperations([&] { it = b.get_to_distance(it, -distance); });
+		ASSERT_EQ(it, b.begin());
+		ASSERT_LE(backward.traversals(), buckets + capacity);
+	}
+}
+
+TEST(complexity, get_to_distance_between_partial_buckets)
+{
+	const size_t capacity = 16;
+	bs_sizet_t b = bs_sizet_t(capacity);
+	b.set_parallelism(1);
+	for (size_t i = 0; i < 10000; ++i)
+		b.insert(i);
+	const size_t buckets = b.capacity() / capacity;
+
+	for (ptrdiff_t from : { 15, 5007, 9998 })
+	{
+		for (ptrdiff_t to : { 1, 8, 14, 4993 })
+		{
+			if (to >= from)
+				continue;
+
+			bs_sizet_t::iterator it = b.get_to_distance(b.begin(), from);
+			OperationCounters backward = countOperations([&] { it = b.get_to_distance(it, to - from); });
+			ASSERT_EQ(*it, size_t(to));
+			ASSERT_LE(backward.traversals(), buckets + 2 * capacity);
+		}
+	}
+}
+
+TEST(complexity, clear_linear)
+{
+	for (size_t n : { 1000, 16000 })
+	{
+		bs_sizet_t b = bs_sizet_t(16);
+		b.set_parallelism(1);
+		for (size_t i = 0; i < n; ++i)
+			b.insert(i);
+		const size_t buckets = b.capacity() / 16;
+
+		OperationCounters delta = countOperations([&] { b.clear(); });
+		ASSERT_LE(delta.traversals(), n + 2 * buckets);
+		ASSERT_LE(delta.metadataWrites, 4);
+		ASSERT_EQ(delta.deallocations, buckets);
+	}
+}
+
+#ifdef BUCKET_STORAGE_GENERATIONS
+TEST(generations, stale_iterators)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 12; ++i)
+		its.push_back(b.insert(i));
+	ASSERT_TRUE(std::all_of(its.begin(), its.end(), [&b](bs_sizet_t::iterator it) { return b.valid(it); }));
+	ASSERT_FALSE(b.valid(b.end()));
+
+	b.erase(its[1]);
+	ASSERT_FALSE(b.valid(its[1]));
+	auto reused = b.insert(size_t(100));
+	ASSERT_EQ(&*reused, &*its[1]);
+	ASSERT_FALSE(b.valid(its[1]));
+	ASSERT_TRUE(b.valid(reused));
+
+	for (size_t i = 4; i < 8; ++i)
+		b.erase(its[i]);
+	ASSERT_FALSE(b.valid(its[4]));
+	auto fresh = b.insert(size_t(200));
+	ASSERT_TRUE(b.valid(fresh));
+	ASSERT_FALSE(b.valid(its[7]));
+	ASSERT_TRUE(b.valid(its[8]));
+
+	bs_sizet_t::const_iterator walked = b.cbegin();
+	std::advance(walked, 3);
+	ASSERT_TRUE(b.valid(walked));
+
+	bs_sizet_t copy(b);
+	ASSERT_FALSE(copy.valid(its[8]));
+	ASSERT_TRUE(copy.valid(copy.begin()));
+
+	bs_sizet_t other(4);
+	other.insert(size_t(1));
+	other.merge(b);
+	ASSERT_FALSE(other.valid(its[8]));
+	for (auto it = other.begin(); it != other.end(); ++it)
+		ASSERT_TRUE(other.valid(it));
+
+	other.clear();
+	ASSERT_FALSE(other.valid(fresh));
+}
+#endif
+
+TEST(frozen, freeze_and_thaw)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 1000; ++i)
+		its.push_back(b.insert(i));
+	for (size_t i = 0; i < 1000; i += 7)
+		b.erase(its[i]);
+	std::vector< size_t > expected(b.begin(), b.end());
+	size_t usage = b.memory_usage();
+
+	bs_sizet_t::frozen_storage frozen = b.freeze();
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(b.capacity(), 0);
+	ASSERT_EQ(frozen.size(), expected.size());
+	ASSERT_EQ(frozen.bucket_count(), 63);
+	ASSERT_LT(frozen.memory_usage(), usage);
+	ASSERT_TRUE(std::equal(frozen.begin(), frozen.end(), expected.begin(), expected.end()));
+	ASSERT_EQ(frozen[500], expected[500]);
+	ASSERT_THROW(frozen.at(expected.size()), std::out_of_range);
+
+	size_t total = 0;
+	for (size_t i = 0; i < frozen.bucket_count(); ++i)
+		total += frozen.bucket(i).size();
+	ASSERT_EQ(total, frozen.size());
+	ASSERT_EQ(frozen.bucket(1).front(), 16);
+
+	bs_sizet_t thawed = frozen.thaw();
+	ASSERT_TRUE(frozen.empty());
+	ASSERT_EQ(thawed.size(), expected.size());
+	ASSERT_EQ(thawed.capacity(), (expected.size() + 15) / 16 * 16);
+	ASSERT_TRUE(std::equal(thawed.begin(), thawed.end(), expected.begin(), expected.end()));
+}
+
+TEST(order, bulk_build_sorted_and_stable_order)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	std::vector< bs_sizet_t::iterator > its;
+	for (size_t i = 0; i < 40; ++i)
+		its.push_back(b.insert(i));
+	for (size_t i = 0; i < 40; i += 3)
+		b.erase(its[i]);
+	size_t kept = b.size();
+
+	std::vector< size_t > sorted(100);
+	std::iota(sorted.begin(), sorted.end(), 1000);
+	b.bulk_build_sorted(sorted);
+	ASSERT_EQ(b.size(), kept + 100);
+	ASSERT_TRUE(std::equal(sorted.begin(), sorted.end(), std::next(b.begin(), kept)));
+
+	std::vector< bs_sizet_t::id_type > ids;
+	for (const auto& bucket : b.buckets())
+		ids.push_back(bucket.id());
+	ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+	ASSERT_EQ(*std::next(b.begin(), kept + 16), 1016);
+
+	b.set_stable_order(true);
+	b.erase(b.begin());
+	for (size_t i = 2000; i < 2040; ++i)
+		b.insert(i);
+	std::vector< size_t > tail(std::prev(b.end(), 40), b.end());
+	for (size_t i = 0; i < 40; ++i)
+		ASSERT_EQ(tail[i], 2000 + i);
+	ASSERT_EQ(*b.begin(), 2);
+	ASSERT_TRUE(b.stable_order());
+}
+
+TEST(order, bulk_build_sorted_throws_on_bucket_boundary)
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	auto throwing = std::views::iota(size_t(0), size_t(8)) |
+					std::views::transform(
+						[](size_t value)
+						{
+							if (value == 4)
+								throw std::runtime_error("boundary");
+							return value;
+						});
+	ASSERT_THROW(b.bulk_build_sorted(throwing), std::runtime_error);
+	ASSERT_EQ(b.size(), 4);
+	ASSERT_EQ(b.capacity(), 4);
+
+	for (size_t i = 4; i < 12; ++i)
+		b.insert(i);
+	ASSERT_EQ(b.size(), 12);
+	std::vector< size_t > values(b.begin(), b.end());
+	std::sort(values.begin(), values.end());
+	for (size_t i = 0; i < 12; ++i)
+		ASSERT_EQ(values[i], i);
+}
+
+TEST(multi, per_type_chains)
+{
+	struct Wide
+	{
+		size_t values[8];
+	};
+	using multi_type = MultiBucketStorage< size_t, Wide, std::string >;
+	static_assert(multi_type::index_of< Wide > == 1);
+	static_assert(!multi_type::holds_type< int >);
+
+	multi_type m(16);
+	std::vector< multi_type::handle > handles;
+	for (size_t i = 0; i < 100; ++i)
+	{
+		handles.push_back(m.insert(i));
+		if (i % 10 == 0)
+			handles.push_back(m.insert(Wide{ { i } }));
+		if (i % 25 == 0)
+			handles.push_back(m.insert(std::to_string(i)));
+	}
+	ASSERT_EQ(m.size(), 100 + 10 + 4);
+	ASSERT_EQ(m.of< size_t >().size(), 100);
+	ASSERT_EQ(m.of< Wide >().size(), 10);
+	ASSERT_EQ(m.of< std::string >().size(), 4);
+	using variant_storage = BucketStorage< std::variant< size_t, Wide, std::string > >;
+	ASSERT_LT(m.memory_usage(), variant_storage::bytes_for(m.size(), 16));
+
+	ASSERT_EQ(handles[1].type_index(), 1);
+	ASSERT_TRUE(handles[2].holds< std::string >());
+	ASSERT_EQ(m.get< Wide >(handles[1]).values[0], 0);
+	ASSERT_EQ(m.visit(handles[2], [](const auto& value) { return sizeof(value); }), sizeof(std::string));
+
+	size_t sum = 0;
+	for (size_t value : m.of< size_t >())
+		sum += value;
+	ASSERT_EQ(sum, 4950);
+
+	size_t visited = 0;
+	size_t wideSum = 0;
+	m.for_each(
+		[&](const auto& value)
+		{
+			++visited;
+			if constexpr (std::is_same_v< std::remove_cvref_t< decltype(value) >, Wide >)
+				wideSum += value.values[0];
+		});
+	ASSERT_EQ(visited, m.size());
+	ASSERT_EQ(wideSum, 450);
+
+	m.erase(handles[1]);
+	m.erase(handles[2]);
+	ASSERT_EQ(m.of< Wide >().size(), 9);
+	ASSERT_EQ(m.of< std::string >().size(), 3);
+
+	multi_type other;
+	other.swap(m);
+	ASSERT_TRUE(m.empty());
+	ASSERT_EQ(other.size(), 112);
+}
+
+TEST(query, fused_pipeline)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	for (size_t i = 0; i < 5000; ++i)
+		b.insert(i);
+
+	auto even = [](size_t value) { return value % 2 == 0; };
+	auto square = [](size_t value) { return value * value; };
+	size_t expectedSum = 0;
+	size_t expectedCount = 0;
+	for (size_t value : b)
+	{
+		if (even(value))
+		{
+			expectedSum += square(value);
+			++expectedCount;
+		}
+	}
+
+	ASSERT_EQ(b | query_where(even) | query_select(square) | query_sum(), expectedSum);
+	ASSERT_EQ(b | query_where(even) | query_count(), expectedCount);
+	ASSERT_EQ(b | query_select([](size_t value) { return double(value) / 2; }) | query_sum(), 5000.0 * 4999 / 4);
+	ASSERT_EQ(b | query_where([](size_t value) { return value > 4990; }) |
+				  query_reduce(size_t(0), [](size_t first, size_t second) { return std::max(first, second); }),
+			  4999);
+
+	b.set_parallelism(4);
+	ASSERT_EQ(b | query_where(even) | query_select(square) | query_sum(), expectedSum);
+
+	bs_sizet_t::frozen_storage frozen = b.freeze();
+	ASSERT_EQ(frozen | query_where(even) | query_select(square) | query_sum(), expectedSum);
+	ASSERT_EQ(frozen | query_where(even) | query_count(), expectedCount);
+}
+
+TEST(query, group_aggregate)
+{
+	bs_sizet_t b = bs_sizet_t(16);
+	for (size_t i = 0; i < 20000; ++i)
+		b.insert(i);
+	b.set_parallelism(4);
+
+	auto byRemainder = b | query_group_aggregate([](size_t value) { return value % 10; }, query_count());
+	ASSERT_EQ(byRemainder.size(), 10);
+	for (size_t key = 0; key < 10; ++key)
+		ASSERT_EQ(*byRemainder.find(key), 2000);
+	ASSERT_EQ(byRemainder.find(10), nullptr);
+
+	for (size_t bits : { 0, 4 })
+	{
+		auto byPair = b | query_where([](size_t value) { return value % 3 != 0; }) |
+					  query_group_aggregate([](size_t value) { return value / 2; }, query_sum(), bits);
+		ASSERT_EQ(byPair.partition_count(), size_t(1) << bits);
+
+		std::unordered_map< size_t, size_t > expected;
+		for (size_t value : b)
+			if (value % 3 != 0)
+				expected[value / 2] += value;
+		ASSERT_EQ(byPair.size(), expected.size());
+		size_t visited = 0;
+		byPair.for_each(
+			[&](size_t key, size_t total)
+			{
+				ASSERT_EQ(total, expected.at(key));
+				++visited;
+			});
+		ASSERT_EQ(visited, expected.size());
+	}
+}
+
+struct JoinUser
+{
+	size_t id;
+	size_t region;
+};
+
+struct JoinOrder
+{
+	size_t user;
+	size_t amount;
+};
+
+TEST(query, hash_join)
+{
+	BucketStorage< JoinUser > users(16);
+	for (size_t id = 0; id < 500; ++id)
+		users.insert(JoinUser{ id, id % 7 });
+	BucketStorage< JoinOrder > orders(16);
+	for (size_t i = 0; i < 20000; ++i)
+		orders.insert(JoinOrder{ i * 31 % 600, i });
+	orders.set_parallelism(4);
+
+	std::unordered_map< size_t, size_t > expected;
+	size_t expectedMatches = 0;
+	for (const JoinOrder& order : orders)
+	{
+		if (order.user < 500)
+		{
+			expected[order.user % 7] += order.amount;
+			++expectedMatches;
+		}
+	}
+
+	auto byUser = [](const JoinUser& user) { return user.id; };
+	auto byOrder = [](const JoinOrder& order) { return order.user; };
+	for (bool usersFirst : { true, false })
+	{
+		std::unordered_map< size_t, size_t > totals;
+		size_t batches = 0;
+		size_t emitted = 0;
+		size_t matches = 0;
+		if (usersFirst)
+			matches = query_hash_join(users,
+									  orders,
+									  byUser,
+									  byOrder,
+									  [&](std::span< const std::pair< const JoinUser*, const JoinOrder* > > batch)
+									  {
+										  ++batches;
+										  emitted += batch.size();
+										  for (const auto& [user, order] : batch)
+											  totals[user->region] += order->amount;
+									  },
+									  256);
+		else
+			matches = query_hash_join(orders,
+									  users,
+									  byOrder,
+									  byUser,
+									  [&](std::span< const std::pair< const JoinOrder*, const JoinUser* > > batch)
+									  {
+										  ++batches;
+										  emitted += batch.size();
+										  for (const auto& [order, user] : batch)
+											  totals[user->region] += order->amount;
+									  },
+									  256);
+
+		ASSERT_EQ(matches, expectedMatches);
+		ASSERT_EQ(emitted, expectedMatches);
+		ASSERT_LE(batches, expectedMatches / 256 + 5);
+		ASSERT_EQ(totals, expected);
+	}
+}
+
+constexpr bs_sizet_t buildSquares()
+{
+	bs_sizet_t b = bs_sizet_t(4);
+	std::array< bs_sizet_t::iterator, 10 > its;
+	for (size_t i = 0; i < 10; ++i)
+		its[i] = b.insert(i * i);
+	for (size_t i = 0; i < 10; i += 3)
+		b.erase(its[i]);
+	b.insert(size_t(100));
+
+	bs_sizet_t copy = b;
+	return copy;
+}
+
+TEST(constexpr_storage, materialize)
+{
+	static_assert(buildSquares().size() == 7);
+	static_assert(buildSquares().capacity() == 12);
+
+	static constexpr auto table = materialize_storage< buildSquares >();
+	static_assert(table.size() == 7);
+	static_assert(table[0] == 1 && table[2] == 16 && table[5] == 100 && table[6] == 64);
+
+	bs_sizet_t b = buildSquares();
+	ASSERT_TRUE(std::equal(b.begin(), b.end(), table.begin(), table.end()));
+	ASSERT_THROW((void)b.to_array< 3 >(), std::length_error);
+}
+
+TEST(trace, copy_assignment_keeps_recorder)
+{
+	std::stringstream trace;
+	TraceRecorder recorder(trace);
+
+	bs_sizet_t b = bs_sizet_t(4);
+	b.set_trace_recorder(&recorder);
+	for (size_t i = 0; i < 5; ++i)
+		b.insert(i);
+
+	bs_sizet_t other = bs_sizet_t(4);
+	for (size_t i = 0; i < 3; ++i)
+		other.insert(i);
+	b = other;
+	ASSERT_EQ(recorder.size(), 3);
+	b.erase(b.begin());
+	b.insert(size_t(7));
+	ASSERT_EQ(recorder.size(), 3);
+
+	TraceReader reader(trace);
+	std::vector< TraceOp > ops;
+	while (auto record = reader.next())
+		ops.push_back(record->op);
+	ASSERT_EQ(ops.size(), 5 + 1 + 3 + 2);
+	ASSERT_EQ(ops[5], TraceOp::Clear);
+	ASSERT_EQ(std::count(ops.begin(), ops.end(), TraceOp::Insert), 5 + 3 + 1);
+	ASSERT_EQ(ops[9], TraceOp::Erase);
+}
+
+TEST(trace, move_assignment_keeps_recorder)
+{
+	std::stringstream trace;
+	TraceRecorder recorder(trace);
+	std::stringstream otherTrace;
+	TraceRecorder otherRecorder(otherTrace);
+
+	bs_sizet_t b = bs_sizet_t(4);
+	b.set_trace_recorder(&recorder);
+	for (size_t i = 0; i < 5; ++i)
+		b.insert(i);
+
+	bs_sizet_t other = bs_sizet_t(4);
+	other.set_trace_recorder(&otherRecorder);
+	for (size_t i = 0; i < 3; ++i)
+		other.insert(i);
+	size_t otherOps = otherRecorder.size();
+	b = std::move(other);
+	ASSERT_EQ(recorder.size(), 3);
+	b.erase(b.begin());
+	b.insert(size_t(7));
+	ASSERT_EQ(recorder.size(), 3);
+	ASSERT_EQ(otherRecorder.size(), otherOps);
+
+	TraceReader reader(trace);
+	std::vector< TraceOp > ops;
+	while (auto record = reader.next())
+		ops.push_back(record->op);
+	ASSERT_EQ(ops.size(), 5 + 1 + 3 + 2);
+	ASSERT_EQ(ops[5], TraceOp::Clear);
+	ASSERT_EQ(std::count(ops.begin(), ops.end(), TraceOp::Insert), 5 + 3 + 1);
+	ASSERT_EQ(ops[9], TraceOp::Erase);
+}
+
 int main(int argc, char **argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,86 @@
+#ifndef THREAD_AFFINITY_H
+#define THREAD_AFFINITY_H
+
+#include <cstddef>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+// ------------------------------------------
+// START OF THREAD AFFINITY INTERFACE
+// ------------------------------------------
+
+class ThreadAffinityScope
+{
+#if defined(__linux__)
+	cpu_set_t previous;
+#endif
+	bool pinned;
+
+  public:
+	explicit ThreadAffinityScope(std::size_t slot) noexcept;
+	ThreadAffinityScope(const ThreadAffinityScope& other) = delete;
+	~ThreadAffinityScope();
+
+	ThreadAffinityScope& operator=(const ThreadAffinityScope& other) = delete;
+
+	[[nodiscard]] bool active() const noexcept;
+
+	[[nodiscard]] static std::size_t cpu_count() noexcept;
+};
+
+// ------------------------------------------
+// START OF THREAD AFFINITY IMPLEMENTATION
+// ------------------------------------------
+
+inline ThreadAffinityScope::ThreadAffinityScope(std::size_t slot) noexcept : pinned(false)
+{
+#if defined(__linux__)
+	CPU_ZERO(&previous);
+	if (sched_getaffinity(0, sizeof(previous), &previous) != 0)
+		return;
+
+	std::size_t allowed = CPU_COUNT(&previous);
+	if (allowed == 0)
+		return;
+
+	std::size_t target = slot % allowed;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (!CPU_ISSET(cpu, &previous) || target-- != 0)
+			continue;
+
+		cpu_set_t single;
+		CPU_ZERO(&single);
+		CPU_SET(cpu, &single);
+		pinned = sched_setaffinity(0, sizeof(single), &single) == 0;
+		return;
+	}
+#else
+	static_cast< void >(slot);
+#endif
+}
+inline ThreadAffinityScope::~ThreadAffinityScope()
+{
+#if defined(__linux__)
+	if (pinned)
+		sched_setaffinity(0, sizeof(previous), &previous);
+#endif
+}
+inline bool ThreadAffinityScope::active() const noexcept
+{
+	return pinned;
+}
+inline std::size_t ThreadAffinityScope::cpu_count() noexcept
+{
+#if defined(__linux__)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+		return CPU_COUNT(&allowed);
+#endif
+	return 1;
+}
+
+#endif /* THREAD_AFFINITY_H */
@@ -0,0 +1,260 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ------------------------------------------
+// START OF TRACE RECORDER INTERFACE
+// ------------------------------------------
+
+enum class TraceOp : uint8_t
+{
+	Insert = 1,
+	Erase,
+	Clear,
+	ShrinkToFit,
+	Scan
+};
+
+struct TraceHeader
+{
+	static constexpr uint32_t MAGIC = 0x52545342;
+	static constexpr uint32_t VERSION = 1;
+
+	uint64_t elementSize = 0;
+	uint64_t blockCapacity = 0;
+};
+
+struct TraceRecord
+{
+	TraceOp op;
+	uint64_t element;
+};
+
+class TraceRecorder
+{
+  public:
+	using id_type = uint64_t;
+	using key_type = std::pair< id_type, id_type >;
+
+  private:
+	struct KeyHash
+	{
+		[[nodiscard]] size_t operator()(const key_type& key) const noexcept;
+	};
+
+	std::ostream* os;
+	std::unordered_map< key_type, id_type, KeyHash > live;
+	id_type nextElement;
+	bool started;
+
+  public:
+	explicit TraceRecorder(std::ostream& os);
+
+	void start(uint64_t elementSize, uint64_t blockCapacity);
+	void insert(id_type bucketId, id_type elementId);
+	void erase(id_type bucketId, id_type elementId);
+	void clear();
+	void scan();
+	void shrinkToFit(const std::vector< key_type >& from, const std::vector< key_type >& to);
+	void resync(const std::vector< key_type >& keys);
+
+	[[nodiscard]] bool isStarted() const noexcept;
+	[[nodiscard]] size_t size() const noexcept;
+
+  private:
+	void write(TraceOp op);
+	void writeVarint(uint64_t value);
+	void writeWord(uint64_t value);
+};
+
+class TraceReader
+{
+	std::istream* is;
+	TraceHeader header;
+
+  public:
+	explicit TraceReader(std::istream& is);
+
+	[[nodiscard]] const TraceHeader& getHeader() const noexcept;
+	[[nodiscard]] std::optional< TraceRecord > next();
+
+  private:
+	[[nodiscard]] uint64_t readVarint();
+	[[nodiscard]] uint64_t readWord();
+};
+
+// ------------------------------------------
+// START OF TRACE RECORDER IMPLEMENTATION
+// ------------------------------------------
+
+inline size_t TraceRecorder::KeyHash::operator()(const key_type& key) const noexcept
+{
+	return std::hash< id_type >()(key.first * 0x9e3779b97f4a7c15ULL ^ key.second);
+}
+inline TraceRecorder::TraceRecorder(std::ostream& os) : os(&os), nextElement(0), started(false) {}
+inline void TraceRecorder::start(uint64_t elementSize, uint64_t blockCapacity)
+{
+	if (started)
+		return;
+
+	writeWord(TraceHeader::MAGIC | (uint64_t(TraceHeader::VERSION) << 32));
+	writeWord(elementSize);
+	writeWord(blockCapacity);
+	started = true;
+}
+inline void TraceRecorder::insert(id_type bucketId, id_type elementId)
+{
+	live.emplace(key_type(bucketId, elementId), nextElement++);
+	write(TraceOp::Insert);
+}
+inline void TraceRecorder::erase(id_type bucketId, id_type elementId)
+{
+	auto found = live.find(key_type(bucketId, elementId));
+	if (found == live.end())
+		return;
+
+	write(TraceOp::Erase);
+	writeVarint(found->second);
+	live.erase(found);
+}
+inline void TraceRecorder::clear()
+{
+	live.clear();
+	write(TraceOp::Clear);
+}
+inline void TraceRecorder::scan()
+{
+	write(TraceOp::Scan);
+}
+inline void TraceRecorder::shrinkToFit(const std::vector< key_type >& from, const std::vector< key_type >& to)
+{
+	std::unordered_map< key_type, id_type, KeyHash > moved;
+	moved.reserve(to.size());
+	for (size_t i = 0; i < from.size() && i < to.size(); ++i)
+	{
+		auto found = live.find(from[i]);
+		if (found != live.end())
+			moved.emplace(to[i], found->second);
+	}
+	live.swap(moved);
+	write(TraceOp::ShrinkToFit);
+}
+inline void TraceRecorder::resync(const std::vector< key_type >& keys)
+{
+	std::unordered_map< key_type, id_type, KeyHash > current;
+	current.reserve(keys.size());
+	for (const key_type& key : keys)
+	{
+		auto found = live.find(key);
+		if (found != live.end())
+		{
+			current.insert(*found);
+			live.erase(found);
+		}
+		else
+		{
+			current.emplace(key, nextElement++);
+			write(TraceOp::Insert);
+		}
+	}
+	for (const auto& stale : live)
+	{
+		write(TraceOp::Erase);
+		writeVarint(stale.second);
+	}
+	live.swap(current);
+}
+inline bool TraceRecorder::isStarted() const noexcept
+{
+	return started;
+}
+inline size_t TraceRecorder::size() const noexcept
+{
+	return live.size();
+}
+inline void TraceRecorder::write(TraceOp op)
+{
+	os->put(char(op));
+}
+inline void TraceRecorder::writeVarint(uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		os->put(char((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	os->put(char(value));
+}
+inline void TraceRecorder::writeWord(uint64_t value)
+{
+	for (int shift = 0; shift < 64; shift += 8)
+		os->put(char((value >> shift) & 0xff));
+}
+
+// ------------------------------------------
+// START OF TRACE READER IMPLEMENTATION
+// ------------------------------------------
+
+inline TraceReader::TraceReader(std::istream& is) : is(&is)
+{
+	uint64_t magic = readWord();
+	if ((magic & 0xffffffff) != TraceHeader::MAGIC || (magic >> 32) != TraceHeader::VERSION)
+		throw std::runtime_error("not a bucket storage trace");
+
+	header.elementSize = readWord();
+	header.blockCapacity = readWord();
+}
+inline const TraceHeader& TraceReader::getHeader() const noexcept
+{
+	return header;
+}
+inline std::optional< TraceRecord > TraceReader::next()
+{
+	int op = is->get();
+	if (op == std::char_traits< char >::eof())
+		return std::nullopt;
+
+	TraceRecord record{ TraceOp(op), 0 };
+	if (record.op == TraceOp::Erase)
+		record.element = readVarint();
+	else if (record.op < TraceOp::Insert || record.op > TraceOp::Scan)
+		throw std::runtime_error("corrupted bucket storage trace");
+	return record;
+}
+inline uint64_t TraceReader::readVarint()
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = is->get();
+		if (byte == std::char_traits< char >::eof())
+			throw std::runtime_error("truncated bucket storage trace");
+		value |= uint64_t(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return value;
+	}
+	throw std::runtime_error("corrupted bucket storage trace");
+}
+inline uint64_t TraceReader::readWord()
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		int byte = is->get();
+		if (byte == std::char_traits< char >::eof())
+			throw std::runtime_error("truncated bucket storage trace");
+		value |= uint64_t(byte) << shift;
+	}
+	return value;
+}
+
+#endif /* TRACE_RECORDER_H */